@@ -0,0 +1,58 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> Allocations(0);
+static std::atomic<size_t> AllocatedBytes(0);
+
+size_t AllocationCounter::Allocations()
+{
+	return ::Allocations;
+}
+
+size_t AllocationCounter::Bytes()
+{
+	return AllocatedBytes;
+}
+
+#if defined(BENCHMARK)
+// Every allocation of the benchmark build is counted, the other builds keep the default allocator.
+void* operator new(size_t size)
+{
+	::Allocations++;
+	AllocatedBytes += size;
+	if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+// Called instead of the two above when the size is known, the library's versions would free with its own allocator.
+void operator delete(void* ptr, size_t size) noexcept
+{
+	(void)size;
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t size) noexcept
+{
+	(void)size;
+	operator delete[](ptr);
+}
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+
+// Allocations made with new since the process started, counted by the benchmark build only.
+// The replaced operators are in their own file, inlined next to a new expression GCC takes their free for a mismatched delete.
+class AllocationCounter
+{
+public:
+	static size_t Allocations();
+	static size_t Bytes();
+};
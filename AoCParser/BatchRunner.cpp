@@ -0,0 +1,175 @@
+#include "BatchRunner.h"
+#include "Parser.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+unsigned int BatchRunner::threads = 0;
+
+using BatchClock = std::chrono::steady_clock;
+
+struct BatchProgram
+{
+	std::unique_ptr<Parser> parser; // Not set when the script couldn't be read or parsed.
+	std::string error;
+};
+
+struct BatchJob
+{
+	std::string script;
+	std::string input; // Empty runs the script with the input it loads itself.
+	BatchProgram* program;
+	std::string output;
+	std::string error;
+	bool passed = false;
+	double milliseconds = 0.0;
+};
+
+static void LoadProgram(const std::string& script, BatchProgram& program)
+{
+	try {
+		std::string code;
+		ReadFile(script, code);
+		program.parser.reset(new Parser(code));
+	}
+	catch (const std::invalid_argument& e) {
+		program.error = e.what();
+	}
+}
+
+static void RunJob(BatchJob& job)
+{
+	BatchClock::time_point start = BatchClock::now();
+	if (job.program->parser == nullptr) {
+		job.error = job.program->error;
+		return;
+	}
+
+	std::ostringstream output;
+	RuntimeGlobals globals;
+	globals.output = &output;
+	globals.InputFileName = job.input;
+	try {
+		job.program->parser->Run(&globals);
+		job.passed = true;
+	}
+	catch (const std::exception& e) {
+		// Failed asserts, runtime errors and missing inputs only fail this job.
+		job.error = e.what();
+	}
+	job.output = output.str();
+	job.milliseconds = std::chrono::duration<double, std::milli>(BatchClock::now() - start).count();
+}
+
+bool BatchRunner::Run(const std::string& manifestPath, std::ostream& out)
+{
+	std::ifstream manifest(manifestPath);
+	if (!manifest.is_open()) {
+		throw std::invalid_argument("Batch manifest not found: " + manifestPath);
+	}
+
+	// Scripts are parsed on this thread, the parser registers statements with the profiler and isn't thread safe.
+	std::map<std::string, std::unique_ptr<BatchProgram>> programs;
+	std::vector<BatchJob> jobs;
+	std::string line;
+	while (std::getline(manifest, line))
+	{
+		std::istringstream words(line);
+		std::string script;
+		if (!(words >> script) || script.compare(0, 2, "//") == 0) {
+			continue;
+		}
+
+		std::unique_ptr<BatchProgram>& program = programs[script];
+		if (program == nullptr) {
+			program.reset(new BatchProgram());
+			LoadProgram(script, *program);
+		}
+
+		BatchJob job;
+		job.script = script;
+		job.program = program.get();
+		std::string input;
+		bool hasInputs = false;
+		while (words >> input)
+		{
+			job.input = input;
+			jobs.push_back(job);
+			hasInputs = true;
+		}
+		if (!hasInputs) {
+			jobs.push_back(job);
+		}
+	}
+
+	size_t threadCount = threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, std::max<size_t>(jobs.size(), 1));
+
+	BatchClock::time_point start = BatchClock::now();
+	std::atomic<size_t> nextJob(0);
+	auto worker = [&]() {
+		for (size_t job = nextJob++; job < jobs.size(); job = nextJob++)
+		{
+			RunJob(jobs[job]);
+		}
+	};
+
+	// This thread runs jobs as well.
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < threadCount; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : workers)
+	{
+		thread.join();
+	}
+	double milliseconds = std::chrono::duration<double, std::milli>(BatchClock::now() - start).count();
+
+	for (const BatchJob& job : jobs)
+	{
+		if (job.output.empty()) {
+			continue;
+		}
+		out << ConsoleColorToString(CONSOLE_COLOR::CYAN) << "Job : " << job.script << " " << job.input
+			<< ConsoleColorToString(CONSOLE_COLOR::RESET) << "\n";
+		out << job.output << "\n";
+	}
+
+	size_t passed = 0;
+	out << "Batch summary:\n";
+	for (const BatchJob& job : jobs)
+	{
+		if (job.passed) {
+			passed++;
+			out << ConsoleColorToString(CONSOLE_COLOR::GREEN) << "PASS";
+		}
+		else {
+			out << ConsoleColorToString(CONSOLE_COLOR::RED) << "FAIL";
+		}
+		out << ConsoleColorToString(CONSOLE_COLOR::RESET);
+		out << std::fixed << std::setprecision(1) << std::setw(10) << job.milliseconds << " ms  " << job.script;
+		if (!job.input.empty()) {
+			out << " " << job.input;
+		}
+		if (!job.passed) {
+			std::string error = job.error;
+			std::replace(error.begin(), error.end(), '\n', ' ');
+			out << "  " << error;
+		}
+		out << "\n";
+	}
+	out << passed << " passed, " << jobs.size() - passed << " failed, " << jobs.size() << " jobs in "
+		<< std::fixed << std::setprecision(1) << milliseconds << " ms on " << threadCount << " threads\n";
+
+	return passed == jobs.size();
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <iostream>
+
+// Runs the jobs of a manifest on a pool of threads, enabled with --batch.
+// Every line of the manifest is a script followed by the inputs to run it with, one job per input:
+//	days/day1.aoc input/day1.txt input/day1_big.txt
+//	days/day3.aoc
+// A script without inputs runs once with the input it loads itself. Empty lines and lines starting with '//' are skipped.
+// Each script is parsed once, every job runs it in its own globals and prints into its own buffer.
+class BatchRunner
+{
+public:
+	static unsigned int threads; // Number of jobs running at the same time, 0 uses all cores. Set with -j.
+
+	// Writes the output of every job in manifest order followed by a summary, returns true if all jobs passed.
+	static bool Run(const std::string& manifestPath, std::ostream& out);
+};
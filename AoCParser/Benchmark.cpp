@@ -0,0 +1,375 @@
+#include "Benchmark.h"
+#include "Parser.h"
+#include "InputCache.h"
+#include "LineIndex.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+// Peak resident set of the whole process in KiB, it never goes down so it covers every case run so far, not only the last one.
+static size_t ProcessPeakRssKiB()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize / 1024;
+#else
+	rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<size_t>(usage.ru_maxrss);
+#endif
+}
+
+// std::uniform_int_distribution differs between standard libraries, the inputs are drawn with plain modulo so every platform
+// generates the same files from the same seed.
+class InputGenerator
+{
+public:
+	InputGenerator(unsigned int seed) : random(seed) {}
+
+	int between(int low, int high) {
+		return low + static_cast<int>(random() % static_cast<unsigned int>(high - low + 1));
+	}
+
+	// Two columns of integers, 'a   b'. The values repeat more as the input grows, like the real lists.
+	std::string day1(size_t lines) {
+		std::string input;
+		int range = static_cast<int>(std::min<size_t>(lines, 89999));
+		for (size_t i = 0; i < lines; i++)
+		{
+			input += std::to_string(10000 + between(0, range)) + "   " + std::to_string(10000 + between(0, range)) + "\n";
+		}
+		return input;
+	}
+
+	// Reports of 5 to 8 levels that mostly increase or decrease by 1 to 3, some break the rules.
+	std::string day2(size_t lines) {
+		std::string input;
+		for (size_t i = 0; i < lines; i++)
+		{
+			int level = between(30, 70);
+			int direction = between(0, 1) == 0 ? -1 : 1;
+			int count = between(5, 8);
+			input += std::to_string(level);
+			for (int j = 1; j < count; j++)
+			{
+				int step = between(0, 9) == 0 ? between(-3, 5) : between(1, 3);
+				level += direction * step;
+				input += " " + std::to_string(level);
+			}
+			input += "\n";
+		}
+		return input;
+	}
+
+	// Corrupted memory with 'mul(a,b)', 'do()' and "don't()" between noise.
+	std::string day3(size_t lines) {
+		static const char* noise[] = { "select()", "how()", "who()", "where()", "#", "%", "[", "]", "mul(4*", "?(12,34)", "mul ( 2 , 4 )", "from()" };
+		std::string input;
+		for (size_t i = 0; i < lines; i++)
+		{
+			std::string line;
+			while (line.length() < 60)
+			{
+				int kind = between(0, 9);
+				if (kind < 4) {
+					line += "mul(" + std::to_string(between(1, 999)) + "," + std::to_string(between(1, 999)) + ")";
+				}
+				else if (kind == 4) {
+					line += "do()";
+				}
+				else if (kind == 5) {
+					line += "don't()";
+				}
+				else {
+					line += noise[between(0, sizeof(noise) / sizeof(noise[0]) - 1)];
+				}
+			}
+			input += line + "\n";
+		}
+		return input;
+	}
+
+private:
+	std::mt19937 random;
+};
+
+// Print statements still format their output, it is just not kept.
+class DiscardBuffer : public std::streambuf
+{
+protected:
+	virtual int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+	virtual std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+struct PhaseSamples
+{
+	std::vector<double> milliseconds;
+	size_t allocations = 0;
+	size_t bytes = 0;
+};
+
+struct BenchmarkCase
+{
+	std::string script;
+	size_t lines;
+	size_t inputBytes;
+	PhaseSamples parse;
+	PhaseSamples execute;
+	size_t processPeakRssKiB; // After the case ran, a case smaller than an earlier one reports the earlier peak.
+	std::string result;
+};
+
+// Nearest rank, p = 0.5 is the median.
+static double Percentile(std::vector<double> samples, double p)
+{
+	std::sort(samples.begin(), samples.end());
+	size_t rank = static_cast<size_t>(p * samples.size() + 0.999999);
+	return samples[std::max<size_t>(rank, 1) - 1];
+}
+
+static void WritePhase(std::ostream& out, const char* name, const PhaseSamples& phase, size_t runs)
+{
+	out << "\"" << name << "\": { \"median_ms\": " << Percentile(phase.milliseconds, 0.5)
+		<< ", \"p95_ms\": " << Percentile(phase.milliseconds, 0.95)
+		<< ", \"allocations\": " << phase.allocations / runs
+		<< ", \"allocated_bytes\": " << phase.bytes / runs << " }";
+}
+
+static BenchmarkCase RunCase(const std::string& script, const std::string& code, const std::string& inputPath, size_t lines, size_t inputBytes, int runs)
+{
+	BenchmarkCase result;
+	result.script = script;
+	result.lines = lines;
+	result.inputBytes = inputBytes;
+	result.result = "ok";
+
+	DiscardBuffer discard;
+	std::ostream output(&discard);
+	for (int run = 0; run < runs; run++)
+	{
+		size_t allocations = AllocationCounter::Allocations();
+		size_t bytes = AllocationCounter::Bytes();
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		std::unique_ptr<Parser> program(new Parser(code));
+		result.parse.milliseconds.push_back(std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count());
+		result.parse.allocations += AllocationCounter::Allocations() - allocations;
+		result.parse.bytes += AllocationCounter::Bytes() - bytes;
+
+		allocations = AllocationCounter::Allocations();
+		bytes = AllocationCounter::Bytes();
+		start = BenchmarkClock::now();
+		{
+			RuntimeGlobals globals;
+			globals.output = &output;
+			globals.InputFileName = inputPath;
+			try {
+				program->Run(&globals);
+			}
+			catch (const std::invalid_argument& e) {
+				// The answers asserted by the scripts don't hold for generated inputs, the assert ends the run.
+				result.result = e.what();
+			}
+		}
+		result.execute.milliseconds.push_back(std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count());
+		result.execute.allocations += AllocationCounter::Allocations() - allocations;
+		result.execute.bytes += AllocationCounter::Bytes() - bytes;
+	}
+	result.processPeakRssKiB = ProcessPeakRssKiB();
+	return result;
+}
+
+// Times finding the lines of a generated Day 2 input of the given size with every method against std::getline, which LOAD used before.
+static int RunLineIndex(std::ostream& out, size_t megabytes, int runs, unsigned int seed)
+{
+	InputGenerator generator(seed);
+	std::string block;
+	while (block.length() < (1 << 20))
+	{
+		block += generator.day2(1000);
+	}
+	std::string text;
+	text.reserve(megabytes << 20);
+	while (text.length() + block.length() <= (megabytes << 20))
+	{
+		text += block;
+	}
+
+	struct IndexCase
+	{
+		std::string name;
+		std::function<size_t()> run; // Returns the number of lines.
+	};
+	std::vector<IndexCase> cases;
+	cases.push_back({ "getline", [&]() {
+		std::istringstream stream(text);
+		std::string line;
+		size_t lines = 0;
+		while (std::getline(stream, line))
+		{
+			lines++;
+		}
+		return lines;
+	} });
+	std::vector<unsigned int> threadCounts = { 1 };
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	if (cores > 1) {
+		threadCounts.push_back(cores);
+	}
+	const std::pair<const char*, LineIndex::Method> methods[] = {
+		{ "memchr", LineIndex::Method::SCALAR }, { "sse2", LineIndex::Method::SSE2 }, { "avx2", LineIndex::Method::AVX2 } };
+	for (const auto& method : methods)
+	{
+		if (!LineIndex::Supported(method.second)) {
+			continue;
+		}
+		for (unsigned int threads : threadCounts)
+		{
+			LineIndex::Method indexMethod = method.second;
+			cases.push_back({ std::string(method.first) + (threads > 1 ? ", " + std::to_string(threads) + " threads" : ""), [&text, indexMethod, threads]() {
+				std::vector<uint64_t> ends;
+				LineIndex::Index(text, ends, threads, indexMethod);
+				return ends.size();
+			} });
+		}
+	}
+
+	out << "Line index of " << (text.length() >> 20) << " MB, median of " << runs << " runs\n";
+	out << std::left << std::setw(24) << "  method" << std::right << std::setw(12) << "ms" << std::setw(10) << "GB/s" << std::setw(14) << "lines" << "\n";
+	out << std::fixed << std::setprecision(2);
+	size_t expectedLines = 0;
+	bool mismatch = false;
+	for (const IndexCase& indexCase : cases)
+	{
+		std::vector<double> milliseconds;
+		size_t lines = 0;
+		for (int run = 0; run < runs; run++)
+		{
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			lines = indexCase.run();
+			milliseconds.push_back(std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count());
+		}
+		expectedLines = expectedLines == 0 ? lines : expectedLines;
+		mismatch = mismatch || lines != expectedLines;
+
+		double median = Percentile(milliseconds, 0.5);
+		out << "  " << std::left << std::setw(22) << indexCase.name << std::right << std::setw(12) << median
+			<< std::setw(10) << text.length() / (median * 1e6) << std::setw(14) << lines << "\n";
+	}
+	if (mismatch) {
+		std::cerr << "The methods found different numbers of lines" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int Benchmark::RunSuite(int argc, char* argv[])
+{
+	size_t maxLines = 10000;
+	int runs = 5;
+	unsigned int seed = 2024;
+	size_t lineIndexMegabytes = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		if (argument == "--nodes") {
+			RunNodes(std::cout);
+			return 0;
+		}
+		else if (argument == "--max-lines" && i + 1 < argc) {
+			maxLines = static_cast<size_t>(std::atoll(argv[++i]));
+		}
+		else if (argument == "--runs" && i + 1 < argc) {
+			runs = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (argument == "--seed" && i + 1 < argc) {
+			seed = static_cast<unsigned int>(std::atoll(argv[++i]));
+		}
+		else if (argument == "--line-index" && i + 1 < argc) {
+			lineIndexMegabytes = static_cast<size_t>(std::max(1ll, std::atoll(argv[++i])));
+		}
+		else {
+			std::cerr << "Benchmark arguments are --max-lines N, --runs N, --seed N, --line-index MB and --nodes, bad argument: '" << argument << "'" << std::endl;
+			return 1;
+		}
+	}
+
+	if (lineIndexMegabytes > 0) {
+		return RunLineIndex(std::cout, lineIndexMegabytes, runs, seed);
+	}
+
+	struct DayScripts
+	{
+		int day;
+		std::vector<std::string> scripts;
+	};
+	const std::vector<DayScripts> days = {
+		{ 1, { "days/day1.aoc", "days/day1b.aoc", "days/day1_reductions.aoc", "days/day1_columns.aoc" } },
+		{ 2, { "days/day2.aoc", "days/day2b.aoc", "days/day2_rows.aoc", "days/day2b_rows.aoc" } },
+		{ 3, { "days/day3.aoc", "days/day3b.aoc" } },
+	};
+
+	// Every run reads its input like a run from the command line does, instead of the input kept by the first run.
+	InputCache::enabled = false;
+
+	std::vector<BenchmarkCase> cases;
+	for (size_t lines = 1000; lines <= maxLines; lines *= 10)
+	{
+		for (const DayScripts& day : days)
+		{
+			InputGenerator generator(seed + day.day);
+			std::string input = day.day == 1 ? generator.day1(lines) : day.day == 2 ? generator.day2(lines) : generator.day3(lines);
+			std::string inputPath = "benchmark_day" + std::to_string(day.day) + "_" + std::to_string(lines) + ".txt";
+			{
+				std::ofstream file(inputPath, std::ios::binary);
+				file << input;
+			}
+
+			for (const std::string& script : day.scripts)
+			{
+				std::string code;
+				ReadFile(script, code);
+				std::cerr << "Benchmark " << script << " " << lines << " lines" << std::endl;
+				cases.push_back(RunCase(script, code, inputPath, lines, input.size(), runs));
+			}
+			std::remove(inputPath.c_str());
+		}
+	}
+
+	std::ostream& out = std::cout;
+	out << std::fixed << std::setprecision(3);
+	out << "{\n\t\"seed\": " << seed << ",\n\t\"runs\": " << runs << ",\n\t\"benchmarks\": [\n";
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		const BenchmarkCase& benchmark = cases[i];
+		out << "\t\t{ \"script\": " << JsonString(benchmark.script) << ", \"lines\": " << benchmark.lines
+			<< ", \"input_bytes\": " << benchmark.inputBytes << ",\n\t\t  ";
+		WritePhase(out, "parse", benchmark.parse, runs);
+		out << ",\n\t\t  ";
+		WritePhase(out, "execute", benchmark.execute, runs);
+		out << ",\n\t\t  \"process_peak_rss_kib\": " << benchmark.processPeakRssKiB << ", \"result\": " << JsonString(benchmark.result) << " }";
+		out << (i + 1 < cases.size() ? ",\n" : "\n");
+	}
+	out << "\t]\n}\n";
+	return 0;
+}
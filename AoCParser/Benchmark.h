@@ -0,0 +1,18 @@
+#pragma once
+#include <ostream>
+
+// Benchmark suite, built by the BENCHMARK configuration.
+// The day scripts are run against generated inputs of 10^3 lines and up, the inputs have the shape of the real Day 1, 2 and 3 inputs
+// and are the same on every platform for a given seed. Parsing and executing are timed separately over several runs and the
+// median, p95, allocations and the peak RSS of the process so far are written to stdout as JSON.
+//	AoCParser --max-lines 10000000 --runs 5 --seed 2024 > benchmark.json
+// With --nodes the cost of evaluating single nodes is measured instead, see NodeBenchmark.cpp.
+// With --line-index 1024 finding the lines of a 1 GB input is timed for every method of LineIndex against std::getline.
+class Benchmark
+{
+public:
+	static int RunSuite(int argc, char* argv[]);
+
+	// Table of ns/op for every node type on minimal trees, with INTEGER and STRING operands where the node takes both.
+	static void RunNodes(std::ostream& out);
+};
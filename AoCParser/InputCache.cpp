@@ -0,0 +1,268 @@
+#include "InputCache.h"
+#include "Parser.h"
+#include "LineIndex.h"
+#include "ParallelLoop.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+bool InputCache::enabled = true;
+bool InputCache::lineIndexFiles = false;
+
+// Bumped whenever the layout of the line index files changes.
+static const uint32_t LineIndexVersion = 1;
+static const char LineIndexMagic[4] = { 'A', 'O', 'C', 'L' };
+static const uint32_t ByteOrder = 0x01020304; // Files are written in the byte order of the machine.
+
+struct FileVersion
+{
+	long long modified = 0;
+	long long size = -1;
+
+	bool operator==(const FileVersion& other) const { return modified == other.modified && size == other.size; }
+};
+
+// A long running process, e.g. the server, keeps at most this many inputs and bytes. The least recently used inputs are
+// dropped first, runs still using a dropped input keep it until they finish.
+static const size_t MaxCachedInputs = 64;
+static const size_t MaxCachedBytes = static_cast<size_t>(1) << 30;
+
+struct CachedInput
+{
+	FileVersion version;
+	std::shared_ptr<const LoadedInput> input;
+	size_t bytes = 0;
+	uint64_t lastUse = 0;
+};
+
+struct InputTable
+{
+	std::mutex mutex;
+	std::map<std::string, CachedInput> inputs;
+	size_t bytes = 0;
+	uint64_t uses = 0;
+};
+
+static InputTable& Inputs()
+{
+	static InputTable table;
+	return table;
+}
+
+static bool GetVersion(const std::string& path, FileVersion& version)
+{
+#if defined(_WIN32)
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0) {
+		return false;
+	}
+	version.modified = static_cast<long long>(info.st_mtime);
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) {
+		return false;
+	}
+#if defined(__linux__)
+	// Nanoseconds, a file rewritten within the same second is still noticed.
+	version.modified = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000ll + info.st_mtim.tv_nsec;
+#else
+	version.modified = static_cast<long long>(info.st_mtime);
+#endif
+#endif
+	version.size = static_cast<long long>(info.st_size);
+	return true;
+}
+
+// Followed by the end offset of every line, the offset of its '\n' or the length of the file for a last line without one.
+struct LineIndexHeader
+{
+	char magic[4];
+	uint32_t byteOrder;
+	uint32_t formatVersion;
+	uint32_t reserved;
+	int64_t modified;
+	int64_t size;
+	uint64_t lineCount;
+};
+
+static void FillHeader(LineIndexHeader& header, const FileVersion& version)
+{
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, LineIndexMagic, sizeof(LineIndexMagic));
+	header.byteOrder = ByteOrder;
+	header.formatVersion = LineIndexVersion;
+	header.modified = version.modified;
+	header.size = version.size;
+}
+
+static std::string LineIndexPath(const std::string& path)
+{
+	return path + ".lineindex";
+}
+
+// Returns false when there is no index for this version of the file, or it doesn't fit the text.
+static bool ReadLineIndex(const std::string& path, const FileVersion& version, const std::string& text, std::vector<uint64_t>& ends)
+{
+	std::ifstream file(LineIndexPath(path), std::ios::binary);
+	LineIndexHeader expected;
+	FillHeader(expected, version);
+	LineIndexHeader header;
+	if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| std::memcmp(&header, &expected, offsetof(LineIndexHeader, lineCount)) != 0 || header.lineCount > text.length()) {
+		return false;
+	}
+
+	ends.resize(static_cast<size_t>(header.lineCount));
+	if (!ends.empty() && !file.read(reinterpret_cast<char*>(ends.data()), ends.size() * sizeof(uint64_t))) {
+		return false;
+	}
+
+	// Only the ends are checked, every line has to end at a newline and the lines have to cover the whole text.
+	uint64_t start = 0;
+	for (uint64_t end : ends)
+	{
+		if (end < start || end > text.length() || (end < text.length() && text[static_cast<size_t>(end)] != '\n')) {
+			return false;
+		}
+		start = end + 1;
+	}
+	return start >= text.length();
+}
+
+// Best effort, like the token cache the file is written next to the final file and renamed.
+static void WriteLineIndex(const std::string& path, const FileVersion& version, const std::vector<uint64_t>& ends)
+{
+	LineIndexHeader header;
+	FillHeader(header, version);
+	header.lineCount = ends.size();
+
+	std::string indexPath = LineIndexPath(path);
+#if defined(_WIN32)
+	std::string temporaryPath = indexPath + ".tmp" + std::to_string(_getpid());
+#else
+	std::string temporaryPath = indexPath + ".tmp" + std::to_string(getpid());
+#endif
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		if (!file.is_open()) {
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(ends.data()), ends.size() * sizeof(uint64_t));
+		if (!file) {
+			file.close();
+			std::remove(temporaryPath.c_str());
+			return;
+		}
+	}
+#if defined(_WIN32)
+	std::remove(indexPath.c_str()); // rename doesn't replace files on Windows.
+#endif
+	if (std::rename(temporaryPath.c_str(), indexPath.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+	}
+}
+
+// version is null when the modification time isn't known, the line index files are only used with it.
+static std::shared_ptr<const LoadedInput> ReadInput(const std::string& path, const FileVersion* version)
+{
+	std::string text;
+	if (!ReadFile(path, text)) {
+		return nullptr;
+	}
+
+	std::vector<uint64_t> ends;
+	bool useIndexFile = InputCache::lineIndexFiles && version != nullptr;
+	if (!useIndexFile || !ReadLineIndex(path, *version, text, ends)) {
+		ends.clear();
+		LineIndex::Index(text, ends, PARALLEL_LOOP_DAY::threads);
+		if (useIndexFile) {
+			WriteLineIndex(path, *version, ends);
+		}
+	}
+
+	std::shared_ptr<LoadedInput> input = std::make_shared<LoadedInput>();
+	input->text = std::make_shared<const std::string>(std::move(text));
+	input->ends = std::move(ends);
+	return input;
+}
+
+static size_t InputBytes(const LoadedInput& input)
+{
+	return input.text->size() + input.ends.size() * sizeof(uint64_t);
+}
+
+// Called with the lock held, keep is the input that was just added.
+static void EvictInputs(InputTable& table, const std::string& keep)
+{
+	while (table.inputs.size() > MaxCachedInputs || table.bytes > MaxCachedBytes)
+	{
+		auto oldest = table.inputs.end();
+		for (auto it = table.inputs.begin(); it != table.inputs.end(); ++it)
+		{
+			if (it->first != keep && (oldest == table.inputs.end() || it->second.lastUse < oldest->second.lastUse)) {
+				oldest = it;
+			}
+		}
+		if (oldest == table.inputs.end()) {
+			return;
+		}
+		table.bytes -= oldest->second.bytes;
+		table.inputs.erase(oldest);
+	}
+}
+
+std::string InputCache::Version(const std::string& path)
+{
+	FileVersion version;
+	if (!GetVersion(path, version)) {
+		return "";
+	}
+	return std::to_string(version.modified) + ":" + std::to_string(version.size);
+}
+
+std::shared_ptr<const LoadedInput> InputCache::Load(const std::string& path)
+{
+	FileVersion version;
+	bool versioned = (enabled || lineIndexFiles) && GetVersion(path, version);
+	if (!enabled || !versioned) {
+		return ReadInput(path, versioned ? &version : nullptr);
+	}
+
+	InputTable& table = Inputs();
+	{
+		std::lock_guard<std::mutex> lock(table.mutex);
+		auto found = table.inputs.find(path);
+		if (found != table.inputs.end() && found->second.version == version) {
+			found->second.lastUse = ++table.uses;
+			return found->second.input;
+		}
+	}
+
+	// Read without the lock, runs loading other inputs don't wait. Two runs loading a new input at once both read it.
+	std::shared_ptr<const LoadedInput> input = ReadInput(path, &version);
+	if (input != nullptr) {
+		std::lock_guard<std::mutex> lock(table.mutex);
+		CachedInput& cached = table.inputs[path];
+		table.bytes -= cached.bytes;
+		cached.version = version;
+		cached.input = input;
+		cached.bytes = InputBytes(*input);
+		cached.lastUse = ++table.uses;
+		table.bytes += cached.bytes;
+		EvictInputs(table, path);
+	}
+	return input;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "StringRef.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A Day input read by a load statement, shared read-only by every run that loads the same file.
+// The lines are only offsets into the text, a LINE value points into the text instead of holding a copy.
+struct LoadedInput
+{
+	std::shared_ptr<const std::string> text;
+	std::vector<uint64_t> ends; // The end of every line, see LineIndex::Index.
+
+	size_t LineCount() const { return ends.size(); }
+
+	// Without the '\r' of "\r\n".
+	StringRef Line(size_t index) const {
+		size_t start = index == 0 ? 0 : static_cast<size_t>(ends[index - 1]) + 1;
+		size_t end = static_cast<size_t>(ends[index]);
+		if (end > start && (*text)[end - 1] == '\r') {
+			end--;
+		}
+		return StringRef(text->data() + start, end - start);
+	}
+};
+
+// Day inputs that have been loaded before in this process, by a load statement in a loop, another script of a batch or another run of the server.
+// The cache is keyed by the path, a file whose modification time or size has changed since it was read is read again.
+// It holds at most 64 inputs and about 1 GB, the least recently used inputs are dropped first.
+// With --line-index the offsets of the lines are also written next to the input (input.txt.lineindex), the next process loading
+// the same file reads them instead of searching the whole file for newlines.
+class InputCache
+{
+public:
+	static bool enabled;
+	static bool lineIndexFiles;
+
+	// Reads and splits the file, or returns the input loaded before. Returns nullptr when the file can't be read.
+	static std::shared_ptr<const LoadedInput> Load(const std::string& path);
+	// Modification time and size of the file, empty when it doesn't exist. Two equal versions mean the file is unchanged.
+	static std::string Version(const std::string& path);
+};
@@ -0,0 +1,57 @@
+#include "Intern.h"
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+
+struct InternStorage
+{
+	std::mutex mutex;
+	// Nodes of an unordered_map never move, the keys double as the stable storage for the strings.
+	std::unordered_map<std::string, Symbol> symbols;
+	std::vector<const std::string*> strings;
+};
+
+static InternStorage& GetStorage()
+{
+	static InternStorage storage;
+	return storage;
+}
+
+Symbol InternTable::Intern(const std::string& str)
+{
+	InternStorage& storage = GetStorage();
+	std::lock_guard<std::mutex> lock(storage.mutex);
+
+	auto found = storage.symbols.find(str);
+	if (found != storage.symbols.end())
+	{
+		return found->second;
+	}
+
+	Symbol symbol = static_cast<Symbol>(storage.strings.size());
+	auto inserted = storage.symbols.emplace(str, symbol);
+	storage.strings.push_back(&inserted.first->first);
+	return symbol;
+}
+
+const std::string* InternTable::Get(Symbol symbol)
+{
+	InternStorage& storage = GetStorage();
+	std::lock_guard<std::mutex> lock(storage.mutex);
+	return storage.strings[symbol];
+}
+
+const std::string* InternTable::SingleChar(char c)
+{
+	static const std::vector<const std::string*> singleChars = []() {
+		std::vector<const std::string*> chars;
+		chars.reserve(256);
+		for (int i = 0; i < 256; i++)
+		{
+			chars.push_back(InternString(std::string(1, static_cast<char>(i))));
+		}
+		return chars;
+	}();
+
+	return singleChars[static_cast<unsigned char>(c)];
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+
+// Handle to an interned string, identifiers are resolved to these once when they are parsed.
+typedef int Symbol;
+
+// Global table of unique strings. Every distinct string is stored exactly once and never freed,
+// so pointers returned by the table stay valid and two interned strings are equal only if their pointers are.
+class InternTable
+{
+public:
+	static Symbol Intern(const std::string& str);
+	static const std::string* Get(Symbol symbol);
+	static const std::string* InternString(const std::string& str) { return Get(Intern(str)); }
+
+	// All 256 single character strings are interned up front, indexing a string or looping over its chars never allocates.
+	static const std::string* SingleChar(char c);
+};
@@ -0,0 +1,261 @@
+#include "LineIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LINE_INDEX_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Below this a thread costs more than it saves.
+static const size_t MinChunkBytes = 8 << 20;
+
+// Newlines are counted first, the ends are written straight into their place in the array without growing it.
+struct NewlineSearch
+{
+	size_t (*count)(const char* data, size_t begin, size_t end);
+	uint64_t* (*find)(const char* data, size_t begin, size_t end, uint64_t* out);
+};
+
+// memchr is vectorized by the C library, unlike a loop over the bytes.
+static size_t CountScalar(const char* data, size_t begin, size_t end)
+{
+	size_t count = 0;
+	const char* cursor = data + begin;
+	const char* last = data + end;
+	while (cursor < last)
+	{
+		const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<size_t>(last - cursor)));
+		if (newline == nullptr) {
+			break;
+		}
+		count++;
+		cursor = newline + 1;
+	}
+	return count;
+}
+
+static uint64_t* FindScalar(const char* data, size_t begin, size_t end, uint64_t* out)
+{
+	const char* cursor = data + begin;
+	const char* last = data + end;
+	while (cursor < last)
+	{
+		const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<size_t>(last - cursor)));
+		if (newline == nullptr) {
+			break;
+		}
+		*out++ = static_cast<uint64_t>(newline - data);
+		cursor = newline + 1;
+	}
+	return out;
+}
+
+#if defined(LINE_INDEX_X86)
+static inline unsigned int TrailingZeros(uint32_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<unsigned int>(index);
+#else
+	return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+static inline uint64_t* AddNewlines(uint32_t mask, size_t offset, uint64_t* out)
+{
+	while (mask != 0)
+	{
+		*out++ = offset + TrailingZeros(mask);
+		mask &= mask - 1;
+	}
+	return out;
+}
+
+// SSE2 is part of every x86-64 CPU. Every byte of the counters counts the newlines at its position,
+// they are summed before they can overflow.
+static size_t CountSse2(const char* data, size_t begin, size_t end)
+{
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t count = 0;
+	size_t i = begin;
+	while (i + 16 <= end)
+	{
+		__m128i counters = _mm_setzero_si128();
+		for (int block = 0; block < 255 && i + 16 <= end; block++, i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(bytes, newline));
+		}
+		__m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+		count += static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_extract_epi16(sums, 4));
+	}
+	return count + CountScalar(data, i, end);
+}
+
+static uint64_t* FindSse2(const char* data, size_t begin, size_t end, uint64_t* out)
+{
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t i = begin;
+	for (; i + 16 <= end; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		out = AddNewlines(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline))), i, out);
+	}
+	return FindScalar(data, i, end, out);
+}
+
+// Compiled for AVX2 without enabling it for the rest of the program, only called after checking the CPU.
+#if defined(__GNUC__)
+#define LINE_INDEX_AVX2 __attribute__((target("avx2")))
+#else
+#define LINE_INDEX_AVX2
+#endif
+
+LINE_INDEX_AVX2 static size_t CountAvx2(const char* data, size_t begin, size_t end)
+{
+	const __m256i newline = _mm256_set1_epi8('\n');
+	size_t count = 0;
+	size_t i = begin;
+	while (i + 32 <= end)
+	{
+		__m256i counters = _mm256_setzero_si256();
+		for (int block = 0; block < 255 && i + 32 <= end; block++, i += 32)
+		{
+			__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(bytes, newline));
+		}
+		uint64_t sums[4];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(sums), _mm256_sad_epu8(counters, _mm256_setzero_si256()));
+		count += static_cast<size_t>(sums[0] + sums[1] + sums[2] + sums[3]);
+	}
+	return count + CountScalar(data, i, end);
+}
+
+LINE_INDEX_AVX2 static uint64_t* FindAvx2(const char* data, size_t begin, size_t end, uint64_t* out)
+{
+	const __m256i newline = _mm256_set1_epi8('\n');
+	size_t i = begin;
+	for (; i + 32 <= end; i += 32)
+	{
+		__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		out = AddNewlines(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline))), i, out);
+	}
+	return FindScalar(data, i, end, out);
+}
+
+static bool CpuHasAvx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	// The OS has to save the AVX registers as well.
+	__cpuid(info, 1);
+	const int osxsave = 1 << 27;
+	const int avx = 1 << 28;
+	if ((info[2] & osxsave) == 0 || (info[2] & avx) == 0 || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+bool LineIndex::Supported(Method method)
+{
+	switch (method)
+	{
+#if defined(LINE_INDEX_X86)
+	case Method::AVX2:
+	{
+		static const bool avx2 = CpuHasAvx2();
+		return avx2;
+	}
+	case Method::SSE2:
+		return true;
+#else
+	case Method::AVX2:
+	case Method::SSE2:
+		return false;
+#endif
+	default:
+		return true;
+	}
+}
+
+static NewlineSearch SelectSearch(LineIndex::Method method)
+{
+	if (method == LineIndex::Method::AUTO) {
+		method = LineIndex::Supported(LineIndex::Method::AVX2) ? LineIndex::Method::AVX2
+			: LineIndex::Supported(LineIndex::Method::SSE2) ? LineIndex::Method::SSE2 : LineIndex::Method::SCALAR;
+	}
+#if defined(LINE_INDEX_X86)
+	if (method == LineIndex::Method::AVX2 && LineIndex::Supported(method)) {
+		return NewlineSearch{ CountAvx2, FindAvx2 };
+	}
+	if (method == LineIndex::Method::SSE2) {
+		return NewlineSearch{ CountSse2, FindSse2 };
+	}
+#endif
+	return NewlineSearch{ CountScalar, FindScalar };
+}
+
+// Runs work(chunk, first, last) for count items split in chunks of at least minChunk, the first chunk on this thread.
+// Returns the number of chunks, the same count and threads always give the same chunks.
+static size_t RunChunks(size_t count, size_t minChunk, unsigned int threads, const std::function<void(size_t, size_t, size_t)>& work)
+{
+	size_t threadCount = threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+	size_t chunks = std::max<size_t>(1, std::min(threadCount, count / minChunk));
+	size_t chunkSize = (count + chunks - 1) / chunks;
+
+	std::vector<std::thread> workers;
+	for (size_t chunk = 1; chunk < chunks; chunk++)
+	{
+		workers.emplace_back(work, chunk, std::min(count, chunk * chunkSize), std::min(count, (chunk + 1) * chunkSize));
+	}
+	work(0, 0, std::min(count, chunkSize));
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	return chunks;
+}
+
+void LineIndex::Index(const std::string& text, std::vector<uint64_t>& ends, unsigned int threads, Method method)
+{
+	NewlineSearch search = SelectSearch(method);
+	const char* data = text.data();
+
+	// Counted per chunk first, so every chunk knows where in ends its newlines go.
+	std::vector<size_t> counts(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency()), 0);
+	size_t chunks = RunChunks(text.length(), MinChunkBytes, threads, [&](size_t chunk, size_t first, size_t last) {
+		counts[chunk] = search.count(data, first, last);
+	});
+
+	std::vector<size_t> offsets(chunks, ends.size());
+	for (size_t chunk = 1; chunk < chunks; chunk++)
+	{
+		offsets[chunk] = offsets[chunk - 1] + counts[chunk - 1];
+	}
+	bool lastLineOpen = !text.empty() && text.back() != '\n';
+	ends.resize(offsets[chunks - 1] + counts[chunks - 1] + (lastLineOpen ? 1 : 0));
+
+	RunChunks(text.length(), MinChunkBytes, threads, [&](size_t chunk, size_t first, size_t last) {
+		search.find(data, first, last, ends.data() + offsets[chunk]);
+	});
+	if (lastLineOpen) {
+		ends.back() = text.length();
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Finds the lines of a Day input. Newlines are searched 32 bytes at a time with AVX2 when the CPU has it and 16 at a time with SSE2
+// on other x86-64 CPUs, elsewhere with memchr. Inputs of more than a few MB are split into chunks that are searched on several threads.
+class LineIndex
+{
+public:
+	enum class Method { AUTO, SCALAR, SSE2, AVX2 };
+
+	// Appends the end of every line of text, the offset of its '\n' or the length of the text for a last line without one.
+	// Lines are split like std::getline splits them, a '\n' at the end of the text doesn't start another line. threads is 0 to use all cores.
+	static void Index(const std::string& text, std::vector<uint64_t>& ends, unsigned int threads, Method method = Method::AUTO);
+
+	static bool Supported(Method method);
+};
@@ -0,0 +1,239 @@
+#include "ListExpressions.h"
+
+// The kernels are plain loops over the unboxed list storage, simple enough for the compiler to vectorize.
+
+template<typename T, typename Operator>
+static void ElementWise(const std::vector<T>& leftValues, const std::vector<T>& rightValues, std::vector<T>& outValues, Operator op)
+{
+	// outValues may be the same vector as leftValues, it already has the right size then.
+	size_t size = leftValues.size();
+	outValues.resize(size);
+	const T* left = leftValues.data();
+	const T* right = rightValues.data();
+	T* out = outValues.data();
+	for (size_t i = 0; i < size; i++)
+	{
+		out[i] = op(left[i], right[i]);
+	}
+}
+
+template<typename T>
+static void Abs(const std::vector<T>& values, std::vector<T>& outValues)
+{
+	size_t size = values.size();
+	outValues.resize(size);
+	const T* in = values.data();
+	T* out = outValues.data();
+	for (size_t i = 0; i < size; i++)
+	{
+		out[i] = in[i] < 0 ? -in[i] : in[i];
+	}
+}
+
+template<typename T, typename Accumulator>
+static Accumulator Sum(const std::vector<T>& values)
+{
+	Accumulator sum = 0;
+	for (T value : values)
+	{
+		sum += value;
+	}
+	return sum;
+}
+
+template<typename T>
+static T Product(const std::vector<T>& values)
+{
+	T product = 1;
+	for (T value : values)
+	{
+		product *= value;
+	}
+	return product;
+}
+
+template<typename T>
+static T Min(const std::vector<T>& values)
+{
+	T min = values[0];
+	for (T value : values)
+	{
+		min = value < min ? value : min;
+	}
+	return min;
+}
+
+template<typename T>
+static T Max(const std::vector<T>& values)
+{
+	T max = values[0];
+	for (T value : values)
+	{
+		max = value > max ? value : max;
+	}
+	return max;
+}
+
+const List& LIST_ELEMENTWISE::evaluateList(RuntimeGlobals* globals, List& scratch)
+{
+	Stats::CountNode("LIST_ELEMENTWISE");
+	// The left operand may be written into scratch, then the result is computed in place.
+	const List& leftList = left->evaluateList(globals, scratch);
+	List rightScratch(leftList.type);
+	const List& rightList = right->evaluateList(globals, rightScratch);
+
+	if (leftList.type != rightList.type) {
+		RuntimeError("Type mismatch: list<" + VariableTypeToString(leftList.type) + "> " + symbol + " list<" + VariableTypeToString(rightList.type) + ">");
+	}
+	if (leftList.type == VariableType::STRING) {
+		RuntimeError("Element-wise '" + symbol + "' is only supported for INTEGER and FLOAT lists");
+	}
+	if (leftList.size() != rightList.size()) {
+		RuntimeError("List sizes don't match: " + std::to_string(leftList.size()) + " " + symbol + " " + std::to_string(rightList.size()));
+	}
+
+	if (&leftList != &scratch) {
+		scratch.clear();
+		scratch.type = leftList.type;
+	}
+
+	if (leftList.type == VariableType::INTEGER) {
+		apply(leftList.ints, rightList.ints, scratch.ints);
+	}
+	else {
+		apply(leftList.floats, rightList.floats, scratch.floats);
+	}
+	return scratch;
+}
+
+void LIST_ELEMENT_ADD::apply(const std::vector<int>& leftValues, const std::vector<int>& rightValues, std::vector<int>& outValues)
+{
+	ElementWise(leftValues, rightValues, outValues, [](int a, int b) { return a + b; });
+}
+
+void LIST_ELEMENT_ADD::apply(const std::vector<float>& leftValues, const std::vector<float>& rightValues, std::vector<float>& outValues)
+{
+	ElementWise(leftValues, rightValues, outValues, [](float a, float b) { return a + b; });
+}
+
+void LIST_ELEMENT_SUBTRACT::apply(const std::vector<int>& leftValues, const std::vector<int>& rightValues, std::vector<int>& outValues)
+{
+	ElementWise(leftValues, rightValues, outValues, [](int a, int b) { return a - b; });
+}
+
+void LIST_ELEMENT_SUBTRACT::apply(const std::vector<float>& leftValues, const std::vector<float>& rightValues, std::vector<float>& outValues)
+{
+	ElementWise(leftValues, rightValues, outValues, [](float a, float b) { return a - b; });
+}
+
+void LIST_ELEMENT_MULT::apply(const std::vector<int>& leftValues, const std::vector<int>& rightValues, std::vector<int>& outValues)
+{
+	ElementWise(leftValues, rightValues, outValues, [](int a, int b) { return a * b; });
+}
+
+void LIST_ELEMENT_MULT::apply(const std::vector<float>& leftValues, const std::vector<float>& rightValues, std::vector<float>& outValues)
+{
+	ElementWise(leftValues, rightValues, outValues, [](float a, float b) { return a * b; });
+}
+
+const List& LIST_ABS::evaluateList(RuntimeGlobals* globals, List& scratch)
+{
+	Stats::CountNode("LIST_ABS");
+	const List& values = arg->evaluateList(globals, scratch);
+	if (values.type == VariableType::STRING) {
+		RuntimeError("abs is only supported for INTEGER and FLOAT lists");
+	}
+
+	if (&values != &scratch) {
+		scratch.clear();
+		scratch.type = values.type;
+	}
+
+	if (values.type == VariableType::INTEGER) {
+		Abs(values.ints, scratch.ints);
+	}
+	else {
+		Abs(values.floats, scratch.floats);
+	}
+	return scratch;
+}
+
+StackVariable LIST_REDUCE::evaluate(RuntimeGlobals* globals)
+{
+	Stats::CountNode("LIST_REDUCE");
+	List scratch(VariableType::INTEGER);
+	const List& values = list->evaluateList(globals, scratch);
+	return reduce(values);
+}
+
+StackVariable LIST_SUM::reduce(const List& values)
+{
+	switch (values.type)
+	{
+	case VariableType::INTEGER:
+		return static_cast<int>(Sum<int, long long>(values.ints));
+	case VariableType::FLOAT:
+		return Sum<float, float>(values.floats);
+	default:
+		RuntimeError("sum is only supported for INTEGER and FLOAT lists");
+	}
+}
+
+StackVariable LIST_PRODUCT::reduce(const List& values)
+{
+	switch (values.type)
+	{
+	case VariableType::INTEGER:
+		return Product(values.ints);
+	case VariableType::FLOAT:
+		return Product(values.floats);
+	default:
+		RuntimeError("product is only supported for INTEGER and FLOAT lists");
+	}
+}
+
+StackVariable LIST_MIN::reduce(const List& values)
+{
+	if (values.size() == 0) {
+		RuntimeError("min of an empty list");
+	}
+
+	switch (values.type)
+	{
+	case VariableType::INTEGER:
+		return Min(values.ints);
+	case VariableType::FLOAT:
+		return Min(values.floats);
+	default:
+		return *std::min_element(values.strings.begin(), values.strings.end());
+	}
+}
+
+StackVariable LIST_MAX::reduce(const List& values)
+{
+	if (values.size() == 0) {
+		RuntimeError("max of an empty list");
+	}
+
+	switch (values.type)
+	{
+	case VariableType::INTEGER:
+		return Max(values.ints);
+	case VariableType::FLOAT:
+		return Max(values.floats);
+	default:
+		return *std::max_element(values.strings.begin(), values.strings.end());
+	}
+}
+
+StackVariable LIST_SEARCH::evaluate(RuntimeGlobals* globals)
+{
+	Stats::CountNode("LIST_SEARCH");
+	StackVariable var = value->evaluate(globals);
+	List scratch(var.type);
+	const List& values = list->evaluateList(globals, scratch);
+	if (var.type != values.type) {
+		RuntimeError("Type mismatch: " + name + " " + VariableTypeToString(var.type) + " in list<" + VariableTypeToString(values.type) + ">");
+	}
+	return search(values, var);
+}
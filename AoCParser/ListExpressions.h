@@ -0,0 +1,224 @@
+#pragma once
+#include "Parser.h"
+
+// Evaluates to a whole list. Lists can't be stored in variables, so the result is either a declared list
+// or the 'scratch' list owned by the caller.
+class ListExpressionNode : public TreeNode
+{
+public:
+	virtual ~ListExpressionNode() override = default;
+	virtual const List& evaluateList(RuntimeGlobals* globals, List& scratch) = 0;
+};
+
+class LIST_ID : public ListExpressionNode
+{
+public:
+	LIST_ID(ID* id, int listSlot) : id(id), listSlot(listSlot) {}
+	virtual ~LIST_ID() override = default;
+	ID* id;
+	int listSlot;
+
+	virtual void print() override { id->print(); }
+	// A declared list is returned as it is, without a copy into the scratch list.
+	virtual const List& evaluateList(RuntimeGlobals* globals, List&) override {
+		Stats::CountNode("LIST_ID");
+		return *globals->get_list(listSlot, id->str);
+	}
+};
+
+// Element-wise operators on two INTEGER or FLOAT lists of equal size.
+class LIST_ELEMENTWISE : public ListExpressionNode
+{
+public:
+	LIST_ELEMENTWISE(ListExpressionNode* left, ListExpressionNode* right, std::string symbol) : left(left), right(right), symbol(symbol) {}
+	virtual ~LIST_ELEMENTWISE() override = default;
+	ListExpressionNode* left;
+	ListExpressionNode* right;
+	std::string symbol;
+
+	virtual void print() override {
+		std::cout << "(";
+		left->print(); std::cout << " " << symbol << " "; right->print();
+		std::cout << ")";
+	}
+	virtual const List& evaluateList(RuntimeGlobals* globals, List& scratch) override;
+
+protected:
+	virtual void apply(const std::vector<int>& leftValues, const std::vector<int>& rightValues, std::vector<int>& outValues) = 0;
+	virtual void apply(const std::vector<float>& leftValues, const std::vector<float>& rightValues, std::vector<float>& outValues) = 0;
+};
+
+class LIST_ELEMENT_ADD : public LIST_ELEMENTWISE
+{
+public:
+	LIST_ELEMENT_ADD(ListExpressionNode* left, ListExpressionNode* right) : LIST_ELEMENTWISE(left, right, "+") {}
+	virtual ~LIST_ELEMENT_ADD() override = default;
+protected:
+	virtual void apply(const std::vector<int>& leftValues, const std::vector<int>& rightValues, std::vector<int>& outValues) override;
+	virtual void apply(const std::vector<float>& leftValues, const std::vector<float>& rightValues, std::vector<float>& outValues) override;
+};
+
+class LIST_ELEMENT_SUBTRACT : public LIST_ELEMENTWISE
+{
+public:
+	LIST_ELEMENT_SUBTRACT(ListExpressionNode* left, ListExpressionNode* right) : LIST_ELEMENTWISE(left, right, "-") {}
+	virtual ~LIST_ELEMENT_SUBTRACT() override = default;
+protected:
+	virtual void apply(const std::vector<int>& leftValues, const std::vector<int>& rightValues, std::vector<int>& outValues) override;
+	virtual void apply(const std::vector<float>& leftValues, const std::vector<float>& rightValues, std::vector<float>& outValues) override;
+};
+
+class LIST_ELEMENT_MULT : public LIST_ELEMENTWISE
+{
+public:
+	LIST_ELEMENT_MULT(ListExpressionNode* left, ListExpressionNode* right) : LIST_ELEMENTWISE(left, right, "*") {}
+	virtual ~LIST_ELEMENT_MULT() override = default;
+protected:
+	virtual void apply(const std::vector<int>& leftValues, const std::vector<int>& rightValues, std::vector<int>& outValues) override;
+	virtual void apply(const std::vector<float>& leftValues, const std::vector<float>& rightValues, std::vector<float>& outValues) override;
+};
+
+class LIST_ABS : public ListExpressionNode
+{
+public:
+	LIST_ABS(ListExpressionNode* arg) : arg(arg) {}
+	virtual ~LIST_ABS() override = default;
+	ListExpressionNode* arg;
+
+	virtual void print() override {
+		std::cout << "(ABS "; arg->print(); std::cout << ")";
+	}
+	virtual const List& evaluateList(RuntimeGlobals* globals, List& scratch) override;
+};
+
+// Reduces a list to a single value.
+class LIST_REDUCE : public ExpressionNode
+{
+public:
+	LIST_REDUCE(ListExpressionNode* list, std::string name) : list(list), name(name) {}
+	virtual ~LIST_REDUCE() override = default;
+	ListExpressionNode* list;
+	std::string name;
+
+	virtual void print() override {
+		std::cout << "(" << name << " "; list->print(); std::cout << ")";
+	}
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override;
+
+protected:
+	virtual StackVariable reduce(const List& values) = 0;
+};
+
+class LIST_SUM : public LIST_REDUCE
+{
+public:
+	LIST_SUM(ListExpressionNode* list) : LIST_REDUCE(list, "SUM") {}
+	virtual ~LIST_SUM() override = default;
+protected:
+	virtual StackVariable reduce(const List& values) override;
+};
+
+class LIST_PRODUCT : public LIST_REDUCE
+{
+public:
+	LIST_PRODUCT(ListExpressionNode* list) : LIST_REDUCE(list, "PRODUCT") {}
+	virtual ~LIST_PRODUCT() override = default;
+protected:
+	virtual StackVariable reduce(const List& values) override;
+};
+
+class LIST_MIN : public LIST_REDUCE
+{
+public:
+	LIST_MIN(ListExpressionNode* list) : LIST_REDUCE(list, "MIN") {}
+	virtual ~LIST_MIN() override = default;
+protected:
+	virtual StackVariable reduce(const List& values) override;
+};
+
+class LIST_MAX : public LIST_REDUCE
+{
+public:
+	LIST_MAX(ListExpressionNode* list) : LIST_REDUCE(list, "MAX") {}
+	virtual ~LIST_MAX() override = default;
+protected:
+	virtual StackVariable reduce(const List& values) override;
+};
+
+// Searches a list for a value, binary search on sorted lists and a linear scan otherwise.
+class LIST_SEARCH : public ExpressionNode
+{
+public:
+	LIST_SEARCH(ExpressionNode* value, ListExpressionNode* list, std::string name) : value(value), list(list), name(name) {}
+	virtual ~LIST_SEARCH() override = default;
+	ExpressionNode* value;
+	ListExpressionNode* list;
+	std::string name;
+
+	virtual void print() override {
+		std::cout << "(" << name << " "; value->print(); std::cout << " IN "; list->print(); std::cout << ")";
+	}
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override;
+
+protected:
+	virtual int search(const List& values, const StackVariable& var) = 0;
+};
+
+// 'count x in list', the number of elements equal to x.
+class LIST_COUNT : public LIST_SEARCH
+{
+public:
+	LIST_COUNT(ExpressionNode* value, ListExpressionNode* list) : LIST_SEARCH(value, list, "COUNT") {}
+	virtual ~LIST_COUNT() override = default;
+protected:
+	virtual int search(const List& values, const StackVariable& var) override { return values.count_equal(var); }
+};
+
+// 'list contains x', 1 if an element is equal to x otherwise 0.
+class LIST_CONTAINS : public LIST_SEARCH
+{
+public:
+	LIST_CONTAINS(ExpressionNode* value, ListExpressionNode* list) : LIST_SEARCH(value, list, "CONTAINS") {}
+	virtual ~LIST_CONTAINS() override = default;
+protected:
+	virtual int search(const List& values, const StackVariable& var) override { return values.find_index(var) >= 0 ? 1 : 0; }
+};
+
+// 'index of x in list', the index of the first element equal to x or -1.
+class LIST_INDEX_OF : public LIST_SEARCH
+{
+public:
+	LIST_INDEX_OF(ExpressionNode* value, ListExpressionNode* list) : LIST_SEARCH(value, list, "INDEX OF") {}
+	virtual ~LIST_INDEX_OF() override = default;
+protected:
+	virtual int search(const List& values, const StackVariable& var) override { return values.find_index(var); }
+};
+
+// 'lower bound of x in list', the number of elements less than x. For a sorted list that is where x would be inserted.
+class LIST_LOWER_BOUND : public LIST_SEARCH
+{
+public:
+	LIST_LOWER_BOUND(ExpressionNode* value, ListExpressionNode* list) : LIST_SEARCH(value, list, "LOWER BOUND OF") {}
+	virtual ~LIST_LOWER_BOUND() override = default;
+protected:
+	virtual int search(const List& values, const StackVariable& var) override { return values.lower_bound(var); }
+};
+
+// 'list = ListExpression', replaces the elements of a declared list. Sorted lists are sorted again.
+class LIST_ASSIGN : public StatementNode
+{
+public:
+	LIST_ASSIGN(ID* id, int listSlot, ListExpressionNode* expression) : id(id), listSlot(listSlot), expression(expression) {}
+	virtual ~LIST_ASSIGN() override = default;
+	ID* id;
+	int listSlot;
+	ListExpressionNode* expression;
+
+	virtual void print() override { id->print(); std::cout << " = "; expression->print(); }
+	virtual void exec(RuntimeGlobals* globals) override {
+		Stats::CountNode("LIST_ASSIGN");
+		List* list = globals->get_list(listSlot, id->str);
+		List scratch(list->type);
+		list->assign(expression->evaluateList(globals, scratch));
+	}
+};
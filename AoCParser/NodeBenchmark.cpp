@@ -0,0 +1,291 @@
+#include "Benchmark.h"
+#include "Parser.h"
+#include "ListExpressions.h"
+#include "ParallelLoop.h"
+#include "Optimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <vector>
+
+using NodeClock = std::chrono::steady_clock;
+
+static const int Samples = 25;
+static const double SampleNanoseconds = 2e6;	// Each sample runs the node for about 2 ms.
+static const double WarmupNanoseconds = 50e6;
+
+struct NodeCase
+{
+	std::string node;
+	std::string operands;
+	std::function<void()> run;
+	size_t opsPerRun; // Loops run their body many times per call.
+	std::function<void()> reset; // Called before every sample, outside of the timing.
+};
+
+struct NodeResult
+{
+	double median;
+	double mean;
+	double stddev;
+	double min;
+	double p95;
+};
+
+// Results are added into this so the evaluations can't be optimized away.
+static volatile int Sink = 0;
+
+// Print statements write here, the cost of formatting is measured without the console.
+class DiscardOutput : public std::streambuf
+{
+protected:
+	virtual int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+	virtual std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+static double TimeRuns(const NodeCase& node, size_t runs)
+{
+	NodeClock::time_point start = NodeClock::now();
+	for (size_t i = 0; i < runs; i++)
+	{
+		node.run();
+	}
+	return std::chrono::duration<double, std::nano>(NodeClock::now() - start).count();
+}
+
+static NodeResult Measure(const NodeCase& node)
+{
+	// Warm up caches and branch predictors while finding how many runs make up one sample.
+	size_t runs = 1;
+	double elapsed = 0.0;
+	double warmup = 0.0;
+	while (warmup < WarmupNanoseconds)
+	{
+		if (node.reset) { node.reset(); }
+		elapsed = TimeRuns(node, runs);
+		warmup += elapsed;
+		if (elapsed < SampleNanoseconds) {
+			runs *= 2;
+		}
+	}
+
+	std::vector<double> samples;
+	for (int i = 0; i < Samples; i++)
+	{
+		if (node.reset) { node.reset(); }
+		samples.push_back(TimeRuns(node, runs) / (runs * node.opsPerRun));
+	}
+	std::sort(samples.begin(), samples.end());
+
+	NodeResult result;
+	result.min = samples.front();
+	result.median = samples[samples.size() / 2];
+	result.p95 = samples[static_cast<size_t>(std::ceil(0.95 * samples.size())) - 1];
+	double sum = 0.0;
+	for (double sample : samples)
+	{
+		sum += sample;
+	}
+	result.mean = sum / samples.size();
+	double squares = 0.0;
+	for (double sample : samples)
+	{
+		squares += (sample - result.mean) * (sample - result.mean);
+	}
+	result.stddev = std::sqrt(squares / (samples.size() - 1));
+	return result;
+}
+
+// Every node type has a case except:
+//	print, debug and trace are the same PRINT_* nodes with another level, disabled ones are removed by the Optimizer before they run.
+//	LIST_ID, LIST_ELEMENT_* and LIST_ABS only run inside another node, they are measured through LIST_ASSIGN.
+//	PARALLEL_LOOP_DAY starts its threads on every run, so its time per line depends on the number of cores more than on the node.
+void Benchmark::RunNodes(std::ostream& out)
+{
+	// The nodes are built by hand like the parser would, owned here instead of by a Parser.
+	std::vector<std::unique_ptr<TreeNode>> nodes;
+	auto make = [&nodes](TreeNode* node) { nodes.emplace_back(node); return node; };
+	auto expression = [&make](ExpressionNode* node) { return static_cast<ExpressionNode*>(make(node)); };
+	auto statement = [&make](StatementNode* node) { return static_cast<StatementNode*>(make(node)); };
+
+	RuntimeGlobals globals;
+	ID* a = static_cast<ID*>(make(new ID("a")));
+	ID* b = static_cast<ID*>(make(new ID("b")));
+	ID* s = static_cast<ID*>(make(new ID("s")));
+	ID* t = static_cast<ID*>(make(new ID("t")));
+	ID* x = static_cast<ID*>(make(new ID("x")));
+	ID* ints = static_cast<ID*>(make(new ID("ints")));
+	ID* strings = static_cast<ID*>(make(new ID("strings")));
+	globals.set_var(a->symbol) = StackVariable(12345);
+	globals.set_var(b->symbol) = StackVariable(678);
+	globals.set_var(s->symbol) = StackVariable(std::string("mul(123,456)"));
+	globals.set_var(t->symbol) = StackVariable(std::string("mul(123,457)"));
+	globals.set_var(x->symbol) = StackVariable(0);
+	DiscardOutput discard;
+	std::ostream discardStream(&discard);
+	globals.output = &discardStream;
+
+	LIST_CREATE* createInts = static_cast<LIST_CREATE*>(statement(new LIST_CREATE(ints, 0, false, VariableType::INTEGER)));
+	LIST_CREATE* createStrings = static_cast<LIST_CREATE*>(statement(new LIST_CREATE(strings, 1, false, VariableType::STRING)));
+	auto fillLists = [&]() {
+		createInts->exec(&globals);
+		createStrings->exec(&globals);
+		for (int i = 0; i < 1000; i++)
+		{
+			globals.lists[0]->push_var(StackVariable(i));
+			globals.lists[1]->push_var(StackVariable(std::to_string(i)));
+		}
+	};
+	fillLists();
+
+	// The Day input of the loops and load statements, two columns of integers like Day 1.
+	const std::string inputPath = "benchmark_nodes.txt";
+	{
+		std::ofstream file(inputPath, std::ios::binary);
+		for (int i = 0; i < 1000; i++)
+		{
+			file << i << "   " << (1000 - i) * 7 % 1000 << "\n";
+		}
+	}
+	globals.DayInput = InputCache::Load(inputPath);
+
+	ID* sortedInts = static_cast<ID*>(make(new ID("sortedInts")));
+	ID* shuffled = static_cast<ID*>(make(new ID("shuffled")));
+	ID* distances = static_cast<ID*>(make(new ID("distances")));
+	ID* left = static_cast<ID*>(make(new ID("left")));
+	ID* right = static_cast<ID*>(make(new ID("right")));
+	ID* row = static_cast<ID*>(make(new ID("row")));
+	ID* count = static_cast<ID*>(make(new ID("count")));
+	ID* total = static_cast<ID*>(make(new ID("total")));
+	ID* text = static_cast<ID*>(make(new ID("text")));
+	statement(new LIST_CREATE(sortedInts, 2, true, VariableType::INTEGER))->exec(&globals);
+	statement(new LIST_CREATE(shuffled, 3, false, VariableType::INTEGER))->exec(&globals);
+	statement(new LIST_CREATE(distances, 4, false, VariableType::INTEGER))->exec(&globals);
+	for (int i = 0; i < 1000; i++)
+	{
+		globals.lists[2]->push_var(StackVariable(i));
+		globals.lists[3]->push_var(StackVariable((i * 7919) % 1000));
+	}
+	LIST_CREATE* createLeft = static_cast<LIST_CREATE*>(statement(new LIST_CREATE(left, 5, false, VariableType::INTEGER)));
+	LIST_CREATE* createRight = static_cast<LIST_CREATE*>(statement(new LIST_CREATE(right, 6, false, VariableType::INTEGER)));
+	LIST_CREATE* createRow = static_cast<LIST_CREATE*>(statement(new LIST_CREATE(row, 7, false, VariableType::INTEGER)));
+	globals.set_var(count->symbol) = StackVariable(0);
+	// Appending grows the variables, they start over for every sample.
+	auto resetAppended = [&]() {
+		globals.set_var(total->symbol) = StackVariable(0);
+		globals.set_var(text->symbol) = StackVariable(std::string(""));
+	};
+
+	ExpressionNode* intA = expression(new INTEGER(12345));
+	ExpressionNode* intIndex = expression(new INTEGER(500));
+	ExpressionNode* strA = expression(new STRING("mul(123,456)"));
+	ExpressionNode* digit = expression(new STRING("7"));
+	ExpressionNode* path = expression(new STRING(inputPath));
+	ListExpressionNode* intsList = static_cast<ListExpressionNode*>(make(new LIST_ID(ints, 0)));
+	ListExpressionNode* sortedList = static_cast<ListExpressionNode*>(make(new LIST_ID(sortedInts, 2)));
+	ListExpressionNode* shuffledList = static_cast<ListExpressionNode*>(make(new LIST_ID(shuffled, 3)));
+	auto body = [&]() { return std::vector<StatementNode*>{ statement(new Statement(statement(new EQUALS(x, intA)), 0, -1)) }; };
+	LOOP_LIST* countLoop = static_cast<LOOP_LIST*>(statement(new LOOP_LIST(ints, 0, body())));
+	StatementNode* sortShuffled = statement(new LIST_SORT(distances, 4));
+	StatementNode* loadInput = statement(new LOAD(path));
+	StatementNode* breakLoop = statement(new BREAK());
+
+	auto evaluate = [&globals](ExpressionNode* node) {
+		return [&globals, node]() { Sink += node->evaluate(&globals).intValue; };
+	};
+	auto exec = [&globals](StatementNode* node) {
+		return [&globals, node]() { node->exec(&globals); };
+	};
+
+	std::vector<NodeCase> cases = {
+		{ "INTEGER", "INTEGER", evaluate(intA), 1, nullptr },
+		{ "STRING", "STRING", evaluate(strA), 1, nullptr },
+		{ "ID", "INTEGER", evaluate(a), 1, nullptr },
+		{ "ID", "STRING", evaluate(s), 1, nullptr },
+		{ "ADD", "INTEGER", evaluate(expression(new ADD(a, b))), 1, nullptr },
+		{ "ADD", "STRING", evaluate(expression(new ADD(s, t))), 1, nullptr },
+		{ "SUBTRACT", "INTEGER", evaluate(expression(new SUBTRACT(a, b))), 1, nullptr },
+		{ "MULT", "INTEGER", evaluate(expression(new MULT(a, b))), 1, nullptr },
+		{ "DIV", "INTEGER", evaluate(expression(new DIV(a, b))), 1, nullptr },
+		{ "MODULO", "INTEGER", evaluate(expression(new MODULO(a, b))), 1, nullptr },
+		{ "NEGATE", "INTEGER", evaluate(expression(new NEGATE(a))), 1, nullptr },
+		{ "ABS", "INTEGER", evaluate(expression(new ABS(a))), 1, nullptr },
+		{ "IS_EQUAL", "INTEGER", evaluate(expression(new IS_EQUAL(a, b))), 1, nullptr },
+		{ "IS_EQUAL", "STRING", evaluate(expression(new IS_EQUAL(s, t))), 1, nullptr },
+		{ "LESS_THAN", "INTEGER", evaluate(expression(new LESS_THAN(a, b))), 1, nullptr },
+		{ "LESS_THAN", "STRING", evaluate(expression(new LESS_THAN(s, t))), 1, nullptr },
+		{ "GREATER_EQUALS", "INTEGER", evaluate(expression(new GREATER_EQUALS(a, b))), 1, nullptr },
+		{ "IS_DIGIT", "STRING", evaluate(expression(new IS_DIGIT(digit))), 1, nullptr },
+		{ "IS_ALPHA", "STRING", evaluate(expression(new IS_ALPHA(digit))), 1, nullptr },
+		{ "CAST", "INTEGER as STRING", evaluate(expression(new CAST(a, VariableType::STRING))), 1, nullptr },
+		{ "CAST", "STRING as INTEGER", evaluate(expression(new CAST(digit, VariableType::INTEGER))), 1, nullptr },
+		{ "LIST_INDEX", "INTEGER", evaluate(expression(new LIST_INDEX(ints, 0, intIndex))), 1, nullptr },
+		{ "LIST_INDEX", "STRING", evaluate(expression(new LIST_INDEX(strings, 1, intIndex))), 1, nullptr },
+		{ "STRING_INDEX", "STRING", evaluate(expression(new STRING_INDEX(s, expression(new INTEGER(4))))), 1, nullptr },
+		{ "LIST_SIZE", "INTEGER", evaluate(expression(new LIST_SIZE(ints, 0))), 1, nullptr },
+		{ "STRING_SIZE", "STRING", evaluate(expression(new STRING_SIZE(s))), 1, nullptr },
+		{ "EQUALS", "INTEGER", exec(statement(new EQUALS(x, intA))), 1, nullptr },
+		{ "EQUALS", "STRING", exec(statement(new EQUALS(x, strA))), 1, nullptr },
+		{ "Statement", "EQUALS INTEGER", exec(statement(new Statement(statement(new EQUALS(x, intA)), 0, -1))), 1, nullptr },
+		{ "LIST_ADD", "INTEGER", exec(statement(new LIST_ADD(ints, 0, intA))), 1, fillLists },
+		{ "LIST_ADD", "STRING", exec(statement(new LIST_ADD(strings, 1, strA))), 1, fillLists },
+		{ "EQUALS_INDEXED", "INTEGER", exec(statement(new EQUALS_INDEXED(ints, 0, intIndex, intA))), 1, nullptr },
+		{ "IF", "INTEGER", exec(statement(new IF(expression(new IS_EQUAL(a, intA)), {}, {}))), 1, nullptr },
+		{ "LOOP", "1000 x EQUALS", exec(statement(new LOOP(expression(new INTEGER(1000)), { statement(new Statement(statement(new EQUALS(x, intA)), 0, -1)) }))), 1000, nullptr },
+		{ "LOOP_LIST", "1000 x EQUALS", exec(statement(new LOOP_LIST(strings, 1, { statement(new Statement(statement(new EQUALS(x, intA)), 0, -1)) }))), 1000, fillLists },
+		{ "FLOAT", "FLOAT", evaluate(expression(new FLOAT(1.5f))), 1, nullptr },
+		{ "GREATER_THAN", "INTEGER", evaluate(expression(new GREATER_THAN(a, b))), 1, nullptr },
+		{ "LESS_EQUALS", "INTEGER", evaluate(expression(new LESS_EQUALS(a, b))), 1, nullptr },
+		{ "APPEND", "INTEGER", exec(statement(new APPEND(total, { expression(new INTEGER(1)) }))), 1, resetAppended },
+		{ "APPEND", "STRING", exec(statement(new APPEND(text, { digit }))), 1, resetAppended },
+		{ "ASSERT", "INTEGER", exec(statement(new ASSERT(expression(new IS_EQUAL(b, b)), strA))), 1, nullptr },
+		{ "BREAK", "", [&]() { breakLoop->exec(&globals); Sink += globals.pop_break(); }, 1, nullptr },
+		{ "PRINT_ID", "INTEGER", exec(statement(new PRINT_ID(a, PrintLevel::PRINT))), 1, nullptr },
+		{ "PRINT_ID", "STRING", exec(statement(new PRINT_ID(t, PrintLevel::PRINT))), 1, nullptr },
+		{ "PRINT_STR", "STRING", exec(statement(new PRINT_STR(strA, PrintLevel::PRINT))), 1, nullptr },
+		{ "PRINT_LIST", "1000 INTEGER", exec(statement(new PRINT_LIST(sortedInts, 2, PrintLevel::PRINT))), 1, nullptr },
+		{ "PRINT_DAY", "1000 lines", exec(statement(new PRINT_DAY(PrintLevel::PRINT))), 1, nullptr },
+		{ "LOAD", "1000 lines, cached", exec(loadInput), 1, nullptr },
+		{ "LOAD", "1000 lines, read", [&]() { InputCache::enabled = false; loadInput->exec(&globals); InputCache::enabled = true; }, 1, nullptr },
+		{ "LOAD_COLUMNS", "1000 x 2 INTEGER", exec(statement(new LOAD_COLUMNS(path, { createLeft, createRight }))), 1, nullptr },
+		{ "LIST_SORT", "1000 INTEGER + copy", [&]() { globals.lists[4]->assign(*globals.lists[3]); sortShuffled->exec(&globals); }, 1, nullptr },
+		{ "LIST_SUM", "1000 INTEGER", evaluate(expression(new LIST_SUM(intsList))), 1, nullptr },
+		{ "LIST_PRODUCT", "1000 INTEGER", evaluate(expression(new LIST_PRODUCT(intsList))), 1, nullptr },
+		{ "LIST_MIN", "1000 INTEGER", evaluate(expression(new LIST_MIN(intsList))), 1, nullptr },
+		{ "LIST_MAX", "1000 INTEGER", evaluate(expression(new LIST_MAX(intsList))), 1, nullptr },
+		{ "LIST_COUNT", "1000 INTEGER", evaluate(expression(new LIST_COUNT(intIndex, intsList))), 1, nullptr },
+		{ "LIST_CONTAINS", "1000 INTEGER", evaluate(expression(new LIST_CONTAINS(intIndex, intsList))), 1, nullptr },
+		{ "LIST_CONTAINS", "1000 sorted", evaluate(expression(new LIST_CONTAINS(intIndex, sortedList))), 1, nullptr },
+		{ "LIST_INDEX_OF", "1000 INTEGER", evaluate(expression(new LIST_INDEX_OF(intIndex, intsList))), 1, nullptr },
+		{ "LIST_INDEX_OF", "1000 sorted", evaluate(expression(new LIST_INDEX_OF(intIndex, sortedList))), 1, nullptr },
+		{ "LIST_LOWER_BOUND", "1000 INTEGER", evaluate(expression(new LIST_LOWER_BOUND(intIndex, intsList))), 1, nullptr },
+		{ "LIST_LOWER_BOUND", "1000 sorted", evaluate(expression(new LIST_LOWER_BOUND(intIndex, sortedList))), 1, nullptr },
+		{ "LIST_ASSIGN", "abs (a - b)", exec(statement(new LIST_ASSIGN(distances, 4, static_cast<ListExpressionNode*>(make(new LIST_ABS(
+			static_cast<ListExpressionNode*>(make(new LIST_ELEMENT_SUBTRACT(shuffledList, sortedList))))))))), 1, nullptr },
+		{ "LIST_ASSIGN", "a + b", exec(statement(new LIST_ASSIGN(distances, 4, static_cast<ListExpressionNode*>(make(new LIST_ELEMENT_ADD(shuffledList, sortedList)))))), 1, nullptr },
+		{ "LIST_ASSIGN", "a * b", exec(statement(new LIST_ASSIGN(distances, 4, static_cast<ListExpressionNode*>(make(new LIST_ELEMENT_MULT(shuffledList, sortedList)))))), 1, nullptr },
+		{ "LOOP_LIST_COUNT", "1000 INTEGER", exec(statement(new LOOP_LIST_COUNT(countLoop, nullptr, intIndex, count, expression(new INTEGER(1))))), 1, nullptr },
+		{ "LOOP_ITERATOR", "12 x EQUALS", exec(statement(new LOOP_ITERATOR(t, body()))), 12, nullptr },
+		{ "LOOP_DAY", "1000 x EQUALS", exec(statement(new LOOP_DAY(body()))), 1000, nullptr },
+		{ "LOOP_DAY_ROWS", "1000 x EQUALS", exec(statement(new LOOP_DAY_ROWS(createRow, body()))), 1000, nullptr },
+	};
+
+	out << std::left << std::setw(18) << "Node" << std::setw(20) << "Operands" << std::right
+		<< std::setw(12) << "median ns" << std::setw(12) << "mean ns" << std::setw(12) << "stddev" << std::setw(12) << "min ns" << std::setw(12) << "p95 ns" << "\n";
+	out << std::fixed << std::setprecision(2);
+	for (const NodeCase& node : cases)
+	{
+		NodeResult result = Measure(node);
+		out << std::left << std::setw(18) << node.node << std::setw(20) << node.operands << std::right
+			<< std::setw(12) << result.median << std::setw(12) << result.mean << std::setw(12) << result.stddev
+			<< std::setw(12) << result.min << std::setw(12) << result.p95 << "\n";
+		out.flush();
+	}
+	std::remove(inputPath.c_str());
+}
@@ -0,0 +1,41 @@
+#include "NumberScanner.h"
+#include <cstring>
+
+bool NumberScanner::ScanLine(const char*& cursor, const char* end, std::vector<int>& values)
+{
+	// memchr is vectorized by the C library, finding the line end first keeps the digit loop free of end checks for '\n'.
+	const char* lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+	if (lineEnd == nullptr) {
+		lineEnd = end;
+	}
+
+	const char* c = cursor;
+	cursor = lineEnd < end ? lineEnd + 1 : end;
+
+	while (c < lineEnd)
+	{
+		if (*c == ' ' || *c == '\t' || *c == '\r') {
+			++c;
+			continue;
+		}
+
+		bool negative = *c == '-';
+		if (negative) {
+			++c;
+		}
+
+		unsigned int digit = 0;
+		if (c >= lineEnd || (digit = static_cast<unsigned char>(*c) - '0') > 9) {
+			return false;
+		}
+
+		int value = 0;
+		while (c < lineEnd && (digit = static_cast<unsigned char>(*c) - '0') <= 9)
+		{
+			value = value * 10 + static_cast<int>(digit);
+			++c;
+		}
+		values.push_back(negative ? -value : value);
+	}
+	return true;
+}
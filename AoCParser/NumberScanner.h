@@ -0,0 +1,11 @@
+#pragma once
+#include <vector>
+
+// Parses whitespace separated integers straight out of a text buffer, without regex, streams or temporary strings.
+class NumberScanner
+{
+public:
+	// Appends the integers on the line starting at cursor to values and moves cursor past the end of the line.
+	// Returns false if the line contains anything but whitespace and integers, cursor is still moved to the next line.
+	static bool ScanLine(const char*& cursor, const char* end, std::vector<int>& values);
+};
@@ -0,0 +1,192 @@
+#include "Optimizer.h"
+#include "ParallelLoop.h"
+#include <algorithm>
+
+void LOOP_LIST_COUNT::exec(RuntimeGlobals* globals)
+{
+	Stats::CountNode("LOOP_LIST_COUNT");
+	List* list = globals->get_list(loop->listSlot, loop->id->str);
+	if (list->size() == 0) {
+		// Nothing is evaluated by the loop, not even 'x'.
+		loop->exec(globals);
+		return;
+	}
+
+	StackVariable valueVar = value->evaluate(globals);
+	if (valueVar.type != list->type) {
+		loop->exec(globals); // Raises the type mismatch on the first comparison.
+		return;
+	}
+
+	int matches = list->count_var(valueVar);
+	if (matches > 0) {
+		StackVariable incrementVar = increment->evaluate(globals);
+		StackVariable* counterVar = globals->find_var(counter->symbol);
+		if (counterVar == nullptr || counterVar->type != VariableType::INTEGER || incrementVar.type != VariableType::INTEGER) {
+			// Missing counter, type mismatches and repeated string appends are left to the loop.
+			loop->exec(globals);
+			return;
+		}
+		counterVar->intValue += incrementVar.intValue * matches;
+	}
+
+	// Leave the variables as the loop would have.
+	if (alias != nullptr) {
+		globals->set_var(alias->symbol) = list->get_var(list->size() - 1);
+	}
+	globals->erase_var(loop->charSymbol);
+	globals->erase_var(loop->iterSymbol);
+}
+
+void Optimizer::Optimize(StatementNode* statement)
+{
+	if (Statement* wrapper = dynamic_cast<Statement*>(statement)) {
+		// The body is optimized first, so removed prints don't keep a loop from matching.
+		Optimize(wrapper->statement);
+		if (LOOP_LIST* loop = dynamic_cast<LOOP_LIST*>(wrapper->statement)) {
+			StatementNode* optimized = OptimizeListCount(loop);
+			if (optimized != nullptr) {
+				wrapper->statement = optimized;
+			}
+		}
+	}
+	else if (IF* ifNode = dynamic_cast<IF*>(statement)) {
+		Optimize(ifNode->statements);
+		Optimize(ifNode->else_statements);
+	}
+	else if (LOOP* loop = dynamic_cast<LOOP*>(statement)) {
+		Optimize(loop->statements);
+	}
+	else if (LOOP_LIST* loop = dynamic_cast<LOOP_LIST*>(statement)) {
+		Optimize(loop->statements);
+	}
+	else if (LOOP_ITERATOR* loop = dynamic_cast<LOOP_ITERATOR*>(statement)) {
+		Optimize(loop->statements);
+	}
+	else if (LOOP_DAY* loop = dynamic_cast<LOOP_DAY*>(statement)) {
+		Optimize(loop->statements);
+	}
+	else if (PARALLEL_LOOP_DAY* parallel = dynamic_cast<PARALLEL_LOOP_DAY*>(statement)) {
+		Optimize(parallel->loop);
+	}
+}
+
+bool Optimizer::IsRemoved(StatementNode* statement)
+{
+	Statement* wrapper = dynamic_cast<Statement*>(statement);
+	PRINT_STATEMENT* print = dynamic_cast<PRINT_STATEMENT*>(wrapper != nullptr ? wrapper->statement : statement);
+	return print != nullptr && !print->enabled();
+}
+
+void Optimizer::Optimize(std::vector<StatementNode*>& statements)
+{
+	// Disabled prints are dropped from the AST, so they cost nothing when the loop runs.
+	statements.erase(std::remove_if(statements.begin(), statements.end(),
+		[this](StatementNode* statement) { return IsRemoved(statement); }), statements.end());
+
+	for (StatementNode* statement : statements)
+	{
+		Optimize(statement);
+	}
+}
+
+StatementNode* Optimizer::OptimizeListCount(LOOP_LIST* loop)
+{
+	auto unwrap = [](StatementNode* statement) {
+		Statement* wrapper = dynamic_cast<Statement*>(statement);
+		return wrapper != nullptr ? wrapper->statement : statement;
+	};
+
+	std::vector<StatementNode*> body;
+	for (StatementNode* statement : loop->statements)
+	{
+		body.push_back(unwrap(statement));
+	}
+
+	// Optional 'v = CHAR;'
+	ID* alias = nullptr;
+	if (body.size() == 2) {
+		EQUALS* equals = dynamic_cast<EQUALS*>(body[0]);
+		ID* source = equals != nullptr ? dynamic_cast<ID*>(equals->expression) : nullptr;
+		if (source == nullptr || source->symbol != loop->charSymbol || equals->id->symbol == loop->iterSymbol) {
+			return nullptr;
+		}
+		alias = equals->id;
+		body.erase(body.begin());
+	}
+
+	// 'if v == x: counter = counter + k; else:end;'
+	IF* ifNode = body.size() == 1 ? dynamic_cast<IF*>(body[0]) : nullptr;
+	if (ifNode == nullptr || ifNode->statements.size() != 1 || !ifNode->else_statements.empty()) {
+		return nullptr;
+	}
+
+	IS_EQUAL* condition = dynamic_cast<IS_EQUAL*>(ifNode->condition);
+	APPEND* append = dynamic_cast<APPEND*>(unwrap(ifNode->statements[0]));
+	if (condition == nullptr || append == nullptr || append->expressions.size() != 1) {
+		return nullptr;
+	}
+
+	Symbol element = alias != nullptr ? alias->symbol : loop->charSymbol;
+	auto isElement = [element](ExpressionNode* expression) {
+		ID* id = dynamic_cast<ID*>(expression);
+		return id != nullptr && id->symbol == element;
+	};
+
+	ExpressionNode* value = nullptr;
+	if (isElement(condition->left)) {
+		value = condition->right;
+	}
+	else if (isElement(condition->right)) {
+		value = condition->left;
+	}
+	else {
+		return nullptr;
+	}
+
+	ID* counter = append->id;
+	ExpressionNode* increment = append->expressions[0];
+	std::vector<Symbol> modified = { loop->charSymbol, loop->iterSymbol, element, counter->symbol };
+	if (counter->symbol == element || counter->symbol == loop->charSymbol || counter->symbol == loop->iterSymbol
+		|| !IsInvariant(value, modified) || !IsInvariant(increment, modified)) {
+		return nullptr;
+	}
+
+	StatementNode* optimized = new LOOP_LIST_COUNT(loop, alias, value, counter, increment);
+	nodes.push_back(optimized);
+	return optimized;
+}
+
+// The body of a matched loop only assigns variables and never modifies lists,
+// so an expression is invariant as long as it doesn't read any of the modified variables.
+bool Optimizer::IsInvariant(ExpressionNode* expression, const std::vector<Symbol>& modified)
+{
+	if (dynamic_cast<INTEGER*>(expression) || dynamic_cast<FLOAT*>(expression) || dynamic_cast<STRING*>(expression)) {
+		return true;
+	}
+	if (ID* id = dynamic_cast<ID*>(expression)) {
+		return std::find(modified.begin(), modified.end(), id->symbol) == modified.end();
+	}
+	if (OPERATOR* op = dynamic_cast<OPERATOR*>(expression)) {
+		return IsInvariant(op->left, modified) && IsInvariant(op->right, modified);
+	}
+	if (IS_OPERATOR* op = dynamic_cast<IS_OPERATOR*>(expression)) {
+		return IsInvariant(op->left, modified);
+	}
+	if (NEGATE* negate = dynamic_cast<NEGATE*>(expression)) {
+		return IsInvariant(negate->arg, modified);
+	}
+	if (ABS* abs = dynamic_cast<ABS*>(expression)) {
+		return IsInvariant(abs->arg, modified);
+	}
+	if (CAST* cast = dynamic_cast<CAST*>(expression)) {
+		return IsInvariant(cast->left, modified);
+	}
+	if (ARRAY_SIZE* size = dynamic_cast<ARRAY_SIZE*>(expression)) {
+		return IsInvariant(size->id, modified);
+	}
+	if (ARRAY_INDEXING* indexing = dynamic_cast<ARRAY_INDEXING*>(expression)) {
+		return IsInvariant(indexing->id, modified) && IsInvariant(indexing->expression, modified);
+	}
+	return false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "Parser.h"
+
+// Counts how many elements of a list equal an outer loop invariant value, rewritten from:
+//	loop L chars:
+//		v = CHAR;
+//		if v == x: counter = counter + k; else:end;
+//	loopstop;
+// The alias 'v' is optional and the operands of '==' can be in either order.
+class LOOP_LIST_COUNT : public StatementNode
+{
+public:
+	LOOP_LIST_COUNT(LOOP_LIST* loop, ID* alias, ExpressionNode* value, ID* counter, ExpressionNode* increment)
+		: loop(loop), alias(alias), value(value), counter(counter), increment(increment) {}
+	virtual ~LOOP_LIST_COUNT() override = default;
+	LOOP_LIST* loop; // The original loop, executed instead whenever it would raise an error.
+	ID* alias;
+	ExpressionNode* value;
+	ID* counter;
+	ExpressionNode* increment;
+public:
+	virtual void print() override {
+		std::cout << "COUNT ("; value->print(); std::cout << ") IN "; loop->id->print();
+		std::cout << " : "; counter->print(); std::cout << " += COUNT * "; increment->print();
+	}
+	virtual void exec(RuntimeGlobals* globals) override;
+};
+
+// Rewrites statements into faster equivalents before they are executed and removes the prints above the log level.
+// Top level statements are optimized one by one just before they run, see Parser::Parser.
+class Optimizer
+{
+public:
+	Optimizer(std::vector<TreeNode*>& nodes) : nodes(nodes) {}
+	void Optimize(StatementNode* statement);
+	// Top level statements can't be removed from the program, the parser skips them instead.
+	bool IsRemoved(StatementNode* statement);
+
+private:
+	void Optimize(std::vector<StatementNode*>& statements);
+	StatementNode* OptimizeListCount(LOOP_LIST* loop);
+	bool IsInvariant(ExpressionNode* expression, const std::vector<Symbol>& modified);
+
+	std::vector<TreeNode*>& nodes; // New nodes are owned and deleted by the parser, like all other nodes.
+};
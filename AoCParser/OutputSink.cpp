@@ -0,0 +1,97 @@
+#include "OutputSink.h"
+#include <algorithm>
+#include <cstring>
+
+static const size_t BufferSize = 1 << 16;
+
+struct ThreadBuffer
+{
+	char data[BufferSize];
+	size_t used = 0;
+	FILE* file = nullptr;
+
+	// fwrite locks the FILE, so a block is never interleaved with the block of another thread.
+	void write(size_t count) {
+		if (count == 0) {
+			return;
+		}
+		std::fwrite(data, 1, count, file);
+		std::memmove(data, data + count, used - count);
+		used -= count;
+	}
+
+	// A full buffer keeps its last unfinished line, unless the whole buffer is one line.
+	void writeLines() {
+		size_t count = used;
+		while (count > 0 && data[count - 1] != '\n')
+		{
+			count--;
+		}
+		write(count > 0 ? count : used);
+	}
+
+	// Output of threads that end without flushing isn't lost.
+	~ThreadBuffer() {
+		write(used);
+	}
+};
+
+static thread_local ThreadBuffer Buffer;
+
+static void Append(FILE* file, const char* s, size_t count)
+{
+	ThreadBuffer& buffer = Buffer;
+	if (buffer.file != file) {
+		buffer.write(buffer.used);
+		buffer.file = file;
+	}
+
+	while (count > 0)
+	{
+		size_t copied = std::min(count, BufferSize - buffer.used);
+		std::memcpy(buffer.data + buffer.used, s, copied);
+		buffer.used += copied;
+		s += copied;
+		count -= copied;
+		if (buffer.used == BufferSize) {
+			buffer.writeLines();
+		}
+	}
+}
+
+OutputSink::OutputSink(std::ostream& stream, FILE* file) : stream(stream), previous(nullptr), file(file)
+{
+	stream.flush();
+	previous = stream.rdbuf(this);
+}
+
+OutputSink::~OutputSink()
+{
+	sync();
+	stream.rdbuf(previous);
+}
+
+OutputSink::int_type OutputSink::overflow(int_type c)
+{
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		char character = traits_type::to_char_type(c);
+		Append(file, &character, 1);
+	}
+	return traits_type::not_eof(c);
+}
+
+std::streamsize OutputSink::xsputn(const char* s, std::streamsize count)
+{
+	Append(file, s, static_cast<size_t>(count));
+	return count;
+}
+
+// Only the buffer of the calling thread is written, the buffers of other threads are written when they flush or end.
+int OutputSink::sync()
+{
+	ThreadBuffer& buffer = Buffer;
+	if (buffer.file == file) {
+		buffer.write(buffer.used);
+	}
+	return std::fflush(file) == 0 ? 0 : -1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <streambuf>
+#include <ostream>
+#include <cstdio>
+
+// Replaces the buffer of a stream (std::cout) while it is alive, so a print is a copy into memory instead of a write to the console.
+// Each thread appends to its own buffer, which is written to the file in one block when the stream is flushed or the buffer is full.
+// A full buffer is only written up to its last newline so lines printed by different threads never get mixed.
+class OutputSink : public std::streambuf
+{
+public:
+	OutputSink(std::ostream& stream, FILE* file);
+	virtual ~OutputSink() override;
+	OutputSink(const OutputSink&) = delete;
+	OutputSink& operator=(const OutputSink&) = delete;
+
+protected:
+	virtual int_type overflow(int_type c) override;
+	virtual std::streamsize xsputn(const char* s, std::streamsize count) override;
+	virtual int sync() override;
+
+private:
+	std::ostream& stream;
+	std::streambuf* previous;
+	FILE* file;
+};
@@ -0,0 +1,307 @@
+#include "ParallelLoop.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+unsigned int PARALLEL_LOOP_DAY::threads = 0;
+
+// Threads that stay alive between parallel loops, a parallel loop inside another loop doesn't start new threads every time it runs.
+// They are started the first time a loop needs them, one less than --threads or the number of cores since the thread running the loop works as well.
+struct WorkerPool
+{
+	// A call of work on up to helpers of the workers, they take the chunks from the counter of the loop.
+	struct Job
+	{
+		const std::function<void()>* work;
+		size_t helpers;
+		size_t running;
+	};
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::deque<Job*> jobs;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void Work()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [&]() { return stopping || !jobs.empty(); });
+			if (stopping) {
+				return;
+			}
+
+			Job* job = jobs.front();
+			if (--job->helpers == 0) {
+				jobs.pop_front();
+			}
+			job->running++;
+			lock.unlock();
+			(*job->work)();
+			lock.lock();
+			if (--job->running == 0) {
+				done.notify_all();
+			}
+		}
+	}
+
+	// Runs work on this thread and on up to helpers workers at once, returns when every call has returned.
+	// Workers busy with another loop, e.g. of another script on the server or the loop this one is nested in, don't join,
+	// the work of a loop is done once this thread's call returns.
+	void Run(size_t helpers, const std::function<void()>& work)
+	{
+		if (helpers == 0) {
+			work();
+			return;
+		}
+
+		Job job{ &work, helpers, 0 };
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			size_t threadCount = PARALLEL_LOOP_DAY::threads != 0 ? PARALLEL_LOOP_DAY::threads : std::max(1u, std::thread::hardware_concurrency());
+			while (workers.size() + 1 < threadCount)
+			{
+				workers.emplace_back([this]() { Work(); });
+			}
+			job.helpers = std::min(helpers, workers.size());
+			if (job.helpers > 0) {
+				jobs.push_back(&job);
+			}
+		}
+		wake.notify_all();
+
+		work();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		auto queued = std::find(jobs.begin(), jobs.end(), &job);
+		if (queued != jobs.end()) {
+			jobs.erase(queued);
+		}
+		done.wait(lock, [&]() { return job.running == 0; });
+	}
+};
+
+static WorkerPool& Workers()
+{
+	static WorkerPool pool;
+	return pool;
+}
+
+// The chunk size only depends on the number of lines, the merge order and thus the result is the same on any machine.
+static size_t ChunkSize(size_t lineCount)
+{
+	return std::max<size_t>(16, lineCount / 256);
+}
+
+// Value of the variable at the start of every chunk, the merge then combines it with the value before the loop.
+static StackVariable Identity(LoopReduction::Operator op, const StackVariable& initial)
+{
+	if (op != LoopReduction::Operator::SUM) {
+		return initial;
+	}
+
+	switch (initial.type)
+	{
+	case VariableType::INTEGER:
+		return StackVariable(0);
+	case VariableType::FLOAT:
+		return StackVariable(0.0f);
+	default:
+		return StackVariable(InternTable::InternString(""));
+	}
+}
+
+static void Reduce(const LoopReduction& reduction, StackVariable& result, const StackVariable& value)
+{
+	if (result.type != value.type) {
+		RuntimeError("Type mismatch in reduction of '" + reduction.id->str + "': "
+			+ VariableTypeToString(result.type) + " and " + VariableTypeToString(value.type));
+	}
+
+	switch (reduction.op)
+	{
+	case LoopReduction::Operator::SUM:
+		if (result.type == VariableType::INTEGER) {
+			result.intValue += value.intValue;
+		}
+		else if (result.type == VariableType::FLOAT) {
+			result.fltValue += value.fltValue;
+		}
+		else {
+			result.GetMutableString() += value.GetString();
+		}
+		break;
+	case LoopReduction::Operator::MIN:
+		if (value < result) {
+			result = value;
+		}
+		break;
+	case LoopReduction::Operator::MAX:
+		if (result < value) {
+			result = value;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+struct ChunkResult
+{
+	std::vector<StackVariable> values;			// One per reduction, unused for CONCAT.
+	std::vector<std::unique_ptr<List>> lists;	// One per reduction, only set for CONCAT.
+	std::string output;
+	bool broken = false;
+	std::exception_ptr error;
+};
+
+void PARALLEL_LOOP_DAY::exec(RuntimeGlobals* globals)
+{
+	Stats::CountNode("PARALLEL_LOOP_DAY");
+	std::vector<StackVariable> initialValues;
+	for (const LoopReduction& reduction : reductions)
+	{
+		if (reduction.op == LoopReduction::Operator::CONCAT) {
+			globals->get_list(reduction.listSlot, reduction.id->str);
+			initialValues.push_back(StackVariable());
+		}
+		else {
+			StackVariable* var = globals->find_var(reduction.id->symbol);
+			if (var == nullptr) {
+				RuntimeError("Reduction variable '" + reduction.id->str + "' must be assigned before the parallel loop");
+			}
+			initialValues.push_back(*var);
+		}
+	}
+
+	size_t lineCount = globals->DayLineCount();
+	size_t chunkSize = ChunkSize(lineCount);
+	size_t chunkCount = (lineCount + chunkSize - 1) / chunkSize;
+	std::vector<ChunkResult> results(chunkCount);
+
+	std::atomic<size_t> nextChunk(0);
+	std::atomic<bool> failed(false);
+	auto worker = [&]() {
+		RuntimeGlobals frame(*globals);
+		std::ostringstream output;
+		frame.output = &output;
+
+		bool prepared = false;
+		while (!failed)
+		{
+			size_t chunk = nextChunk++;
+			if (chunk >= chunkCount) {
+				break;
+			}
+
+			ChunkResult& result = results[chunk];
+			try {
+				if (!prepared) {
+					loop->prepare(&frame);
+					prepared = true;
+				}
+
+				for (size_t i = 0; i < reductions.size(); i++)
+				{
+					const LoopReduction& reduction = reductions[i];
+					if (reduction.op == LoopReduction::Operator::CONCAT) {
+						frame.get_unsettled_list(reduction.listSlot, reduction.id->str)->clear();
+					}
+					else {
+						frame.set_var(reduction.id->symbol) = Identity(reduction.op, initialValues[i]);
+					}
+				}
+
+				size_t first = chunk * chunkSize;
+				result.broken = !loop->execLines(&frame, first, std::min(first + chunkSize, lineCount));
+
+				result.values.resize(reductions.size());
+				result.lists.resize(reductions.size());
+				for (size_t i = 0; i < reductions.size(); i++)
+				{
+					const LoopReduction& reduction = reductions[i];
+					if (reduction.op == LoopReduction::Operator::CONCAT) {
+						result.lists[i].reset(frame.get_list(reduction.listSlot, reduction.id->str)->clone());
+					}
+					else {
+						result.values[i] = reduction.id->get(&frame);
+					}
+				}
+			}
+			catch (...) {
+				result.error = std::current_exception();
+				failed = true;
+			}
+
+			result.output = output.str();
+			output.str("");
+		}
+	};
+
+	size_t threadCount = threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+	if (Profiler::enabled) {
+		// The profiler isn't thread safe, profiled runs execute all chunks on this thread.
+		threadCount = 1;
+	}
+	threadCount = std::min(threadCount, std::max<size_t>(chunkCount, 1));
+
+	// This thread is a worker as well.
+	Workers().Run(threadCount - 1, worker);
+
+	std::vector<StackVariable> values = initialValues;
+	for (ChunkResult& result : results)
+	{
+		*globals->output << result.output;
+		if (result.error) {
+			std::rethrow_exception(result.error);
+		}
+		if (result.broken) {
+			RuntimeError("break can't be used to leave a parallel loop");
+		}
+
+		for (size_t i = 0; i < reductions.size(); i++)
+		{
+			const LoopReduction& reduction = reductions[i];
+			if (reduction.op == LoopReduction::Operator::CONCAT) {
+				List* list = globals->get_unsettled_list(reduction.listSlot, reduction.id->str);
+				const List* chunkList = result.lists[i].get();
+				for (size_t element = 0; element < chunkList->size(); element++)
+				{
+					list->push_var(chunkList->get_var(element));
+				}
+			}
+			else {
+				Reduce(reduction, values[i], result.values[i]);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < reductions.size(); i++)
+	{
+		if (reductions[i].op != LoopReduction::Operator::CONCAT) {
+			globals->set_var(reductions[i].id->symbol) = values[i];
+		}
+	}
+}
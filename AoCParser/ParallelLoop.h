@@ -0,0 +1,44 @@
+#pragma once
+#include "Parser.h"
+
+// 'reduce total sum', how the value a variable or list got in each chunk of a parallel loop is combined.
+struct LoopReduction
+{
+	enum class Operator
+	{
+		SUM,	// Variables, INTEGER and FLOAT are added and STRING is appended.
+		MIN,	// Variables
+		MAX,	// Variables
+		CONCAT,	// Lists, the elements added in each chunk are appended.
+	};
+
+	ID* id;
+	int listSlot; // Only for CONCAT.
+	Operator op;
+};
+
+// 'parallel loop DAY lines reduce total sum:', the lines are split in chunks that run on all cores.
+// Every worker runs in its own copy of the globals, so assignments in the body stay local to the worker
+// except for the reductions. Those are merged in line order, as is the print output of the chunks,
+// which makes the result independent of the number of threads.
+class PARALLEL_LOOP_DAY : public StatementNode
+{
+public:
+	PARALLEL_LOOP_DAY(LOOP_DAY* loop, std::vector<LoopReduction> reductions) : loop(loop), reductions(reductions) {}
+	virtual ~PARALLEL_LOOP_DAY() override = default;
+	LOOP_DAY* loop;
+	std::vector<LoopReduction> reductions;
+public:
+	virtual void print() override {
+		std::cout << "PARALLEL REDUCE (";
+		for (const LoopReduction& reduction : reductions)
+		{
+			std::cout << " "; reduction.id->print();
+		}
+		std::cout << " ) ";
+		loop->print();
+	}
+	virtual void exec(RuntimeGlobals* globals) override;
+
+	static unsigned int threads; // Number of threads to run on, 0 uses all cores. Set with --threads, also used to split large inputs into lines.
+};
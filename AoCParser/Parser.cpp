@@ -1,5 +1,13 @@
 #include "Parser.h"
+#include "Optimizer.h"
+#include "ListExpressions.h"
+#include "NumberScanner.h"
+#include "ParallelLoop.h"
+#include "PerfCounters.h"
+#include "InputCache.h"
 #include <stdexcept> // For standard exception classes
+#include <algorithm>
+#include <cstdint>
 
 // For Reading entire file to string
 #include <fstream>
@@ -7,6 +15,8 @@
 
 #define REGISTER_PTR(ptr, assign) { auto* _register_ptr = ptr; nodes.push_back(_register_ptr); assign = _register_ptr; }
 
+PrintLevel PRINT_STATEMENT::threshold = PrintLevel::PRINT;
+
 bool ReadFile(const std::string& filePath, std::string& fileContents) {
 	std::ifstream file(filePath);
 	if (!file.is_open()) {
@@ -24,19 +34,19 @@ bool ReadFile(const std::string& filePath, std::string& fileContents) {
 	return true;
 }
 
-void SyntaxError(Tokenizer& t, Token token, std::string expected)
+[[noreturn]] void SyntaxError(Tokenizer& t, Token token, std::string expected)
 {
 	throw std::invalid_argument("Syntax error: " + token.ToString() + " " + expected + ".\n At: " + t.GetLastLine());
 }
 
-void RuntimeError(std::string error_message)
+[[noreturn]] void RuntimeError(std::string error_message)
 {
 	throw std::invalid_argument("Runtime error: {" + error_message + "}");
 }
 
-bool Parser::ScanExpression(Token t, TreeNode** outNode)
+bool Parser::ScanExpression(Token t, ExpressionNode** outNode)
 {
-	TreeNode* leftLogic = nullptr;
+	ExpressionNode* leftLogic = nullptr;
 	if (ScanLogic(t, &leftLogic)) {
 		*outNode = leftLogic;
 
@@ -46,7 +56,7 @@ bool Parser::ScanExpression(Token t, TreeNode** outNode)
 			))
 		{
 			tokenizer.GetNextToken(t);
-			TreeNode* op = nullptr;
+			ExpressionNode* op = nullptr;
 			if (t.type == TokenType::IS_DIGIT) {
 				op = new IS_DIGIT(leftLogic);
 			}
@@ -56,7 +66,7 @@ bool Parser::ScanExpression(Token t, TreeNode** outNode)
 			REGISTER_PTR(op, *outNode);
 		}
 		else {
-			TreeNode* rightLogic = nullptr;
+			ExpressionNode* rightLogic = nullptr;
 			while (tokenizer.PeekNextToken(t) && (
 				t.type == TokenType::GREATER_THAN
 				|| t.type == TokenType::GREATER_EQUALS
@@ -68,7 +78,7 @@ bool Parser::ScanExpression(Token t, TreeNode** outNode)
 				TokenType operatorType = t.type;
 				tokenizer.ConsumeNext(); // Need to consume next since PeekNextToken doesn't consume.
 				if (tokenizer.GetNextToken(t) && ScanLogic(t, &rightLogic)) {
-					TreeNode* op = nullptr;
+					ExpressionNode* op = nullptr;
 					if (operatorType == TokenType::GREATER_THAN) {
 						op = new GREATER_THAN(leftLogic, rightLogic);
 					}
@@ -99,19 +109,19 @@ bool Parser::ScanExpression(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanLogic(Token t, TreeNode** outNode)
+bool Parser::ScanLogic(Token t, ExpressionNode** outNode)
 {
-	TreeNode* leftTerm = nullptr;
+	ExpressionNode* leftTerm = nullptr;
 	if (ScanTerm(t, &leftTerm)) {
 		*outNode = leftTerm;
 
-		TreeNode* rightTerm = nullptr;
+		ExpressionNode* rightTerm = nullptr;
 		while (tokenizer.PeekNextToken(t) && (t.type == TokenType::PLUS || t.type == TokenType::MINUS))
 		{
 			TokenType operatorType = t.type;
 			tokenizer.ConsumeNext(); // Need to consume next since PeekNextToken doesn't consume.
 			if (tokenizer.GetNextToken(t) && ScanTerm(t, &rightTerm)) {
-				TreeNode* op = nullptr;
+				ExpressionNode* op = nullptr;
 				if (operatorType == TokenType::PLUS) {
 					op = new ADD(leftTerm, rightTerm);
 				}
@@ -131,9 +141,9 @@ bool Parser::ScanLogic(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanTerm(Token t, TreeNode** outNode)
+bool Parser::ScanTerm(Token t, ExpressionNode** outNode)
 {
-	TreeNode* leftFactor = nullptr;
+	ExpressionNode* leftFactor = nullptr;
 	if (ScanFactor(t, &leftFactor)) {
 		*outNode = leftFactor;
 
@@ -159,7 +169,7 @@ bool Parser::ScanTerm(Token t, TreeNode** outNode)
 			SyntaxError(tokenizer, t, "Expected Cast TYPE but were no tokens left!");
 		}
 		else {
-			TreeNode* rightFactor = nullptr;
+			ExpressionNode* rightFactor = nullptr;
 			while (tokenizer.PeekNextToken(t) && (t.type == TokenType::MULTIPLY || t.type == TokenType::DIVIDE || t.type == TokenType::MODULO))
 			{
 				TokenType operatorType = t.type;
@@ -190,19 +200,89 @@ bool Parser::ScanTerm(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanFactor(Token t, TreeNode** outNode)
+bool Parser::ScanFactor(Token t, ExpressionNode** outNode)
 {
 	if (t.type == TokenType::INTEGER) {
 		REGISTER_PTR(new INTEGER(std::stoi(t.value)), *outNode);
 		return true;
 	}
-	else if (ScanID(t, outNode)) {
-		TreeNode* id = *outNode;
+
+	// List reductions
+	bool isSum = IsKeywordBeforeValue(t, "sum");
+	bool isProduct = IsKeywordBeforeValue(t, "product");
+	bool isMin = IsKeywordBeforeValue(t, "min");
+	if (isSum || isProduct || isMin || IsKeywordBeforeValue(t, "max"))
+	{
+		ListExpressionNode* list = nullptr;
+		if (!(tokenizer.GetNextToken(t) && ScanListOperand(t, &list))) {
+			SyntaxError(tokenizer, t, "Expected list to reduce");
+		}
+
+		if (isSum) {
+			REGISTER_PTR(new LIST_SUM(list), *outNode);
+		}
+		else if (isProduct) {
+			REGISTER_PTR(new LIST_PRODUCT(list), *outNode);
+		}
+		else if (isMin) {
+			REGISTER_PTR(new LIST_MIN(list), *outNode);
+		}
+		else {
+			REGISTER_PTR(new LIST_MAX(list), *outNode);
+		}
+		return true;
+	}
+
+	// List searches
+	bool isCount = IsKeywordBeforeValue(t, "count");
+	if (isCount || t.type == TokenType::LIST_INDEX_OF || t.type == TokenType::LIST_LOWER_BOUND)
+	{
+		TokenType searchType = t.type;
+		ExpressionNode* value = nullptr;
+		if (!(tokenizer.GetNextToken(t) && ScanFactor(t, &value))) {
+			SyntaxError(tokenizer, t, "Expected value to search for");
+		}
+
+		if (!(tokenizer.GetNextToken(t) && t.type == TokenType::ID && t.value == "in")) {
+			SyntaxError(tokenizer, t, "Expected 'in' after search value");
+		}
+
+		ListExpressionNode* list = nullptr;
+		if (!(tokenizer.GetNextToken(t) && ScanListOperand(t, &list))) {
+			SyntaxError(tokenizer, t, "Expected list to search in");
+		}
+
+		if (isCount) {
+			REGISTER_PTR(new LIST_COUNT(value, list), *outNode);
+		}
+		else if (searchType == TokenType::LIST_INDEX_OF) {
+			REGISTER_PTR(new LIST_INDEX_OF(value, list), *outNode);
+		}
+		else {
+			REGISTER_PTR(new LIST_LOWER_BOUND(value, list), *outNode);
+		}
+		return true;
+	}
+
+	if (IsKeywordBeforeValue(t, "abs"))
+	{
+		ExpressionNode* arg = nullptr;
+		if (tokenizer.GetNextToken(t) && ScanFactor(t, &arg))
+		{
+			REGISTER_PTR(new ABS(arg), *outNode);
+			return true;
+		}
+		SyntaxError(tokenizer, t, "Expected factor");
+	}
+
+	ID* id = nullptr;
+	if (ScanID(t, &id)) {
+		*outNode = id;
 		// TODO PEEK NEXT TOKEN FOR "[" EXPRESSION "]"
 		if (tokenizer.PeekNextToken(t) && t.type == TokenType::LBRACKET)
 		{
 			tokenizer.ConsumeNext();
-			TreeNode* expression = nullptr;
+			ExpressionNode* expression = nullptr;
 			if (tokenizer.GetNextToken(t) && !ScanExpression(t, &expression))
 			{
 				SyntaxError(tokenizer, t, "Expected expression");
@@ -215,13 +295,44 @@ bool Parser::ScanFactor(Token t, TreeNode** outNode)
 				return false;
 			}
 
-			REGISTER_PTR(new ARRAY_INDEXING(id, expression), *outNode);
+			int listSlot = GetListSlot(id);
+			if (listSlot >= 0) {
+				REGISTER_PTR(new LIST_INDEX(id, listSlot, expression), *outNode);
+			}
+			else {
+				REGISTER_PTR(new STRING_INDEX(id, expression), *outNode);
+			}
+			return true;
+		}
+		else if (tokenizer.PeekNextToken(t) && t.type == TokenType::LIST_CONTAINS)
+		{
+			tokenizer.ConsumeNext();
+			int listSlot = GetListSlot(id);
+			if (listSlot < 0)
+			{
+				SyntaxError(tokenizer, t, "Using undeclared list : " + id->str);
+			}
+
+			ExpressionNode* value = nullptr;
+			if (!(tokenizer.GetNextToken(t) && ScanFactor(t, &value))) {
+				SyntaxError(tokenizer, t, "Expected value to search for");
+			}
+
+			ListExpressionNode* list = nullptr;
+			REGISTER_PTR(new LIST_ID(id, listSlot), list);
+			REGISTER_PTR(new LIST_CONTAINS(value, list), *outNode);
 			return true;
 		}
 		else if (tokenizer.PeekNextToken(t) && t.type == TokenType::ARRAY_SIZE)
 		{
 			tokenizer.ConsumeNext();
-			REGISTER_PTR(new ARRAY_SIZE(id), *outNode);
+			int listSlot = GetListSlot(id);
+			if (listSlot >= 0) {
+				REGISTER_PTR(new LIST_SIZE(id, listSlot), *outNode);
+			}
+			else {
+				REGISTER_PTR(new STRING_SIZE(id), *outNode);
+			}
 			return true;
 		}
 		return true;
@@ -251,11 +362,11 @@ bool Parser::ScanFactor(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanNegate(Token t, TreeNode** outNode)
+bool Parser::ScanNegate(Token t, ExpressionNode** outNode)
 {
 	if (t.type == TokenType::MINUS)
 	{
-		TreeNode* negateFactor = nullptr;
+		ExpressionNode* negateFactor = nullptr;
 		if (tokenizer.GetNextToken(t) && ScanFactor(t, &negateFactor))
 		{
 			REGISTER_PTR(new NEGATE(negateFactor), *outNode);
@@ -266,18 +377,141 @@ bool Parser::ScanNegate(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanAssignment(Token t, TreeNode** outNode)
+bool Parser::ScanListExpression(Token t, ListExpressionNode** outNode)
+{
+	ListExpressionNode* leftTerm = nullptr;
+	if (ScanListTerm(t, &leftTerm)) {
+		*outNode = leftTerm;
+
+		ListExpressionNode* rightTerm = nullptr;
+		while (tokenizer.PeekNextToken(t) && (t.type == TokenType::PLUS || t.type == TokenType::MINUS))
+		{
+			TokenType operatorType = t.type;
+			tokenizer.ConsumeNext(); // Need to consume next since PeekNextToken doesn't consume.
+			if (tokenizer.GetNextToken(t) && ScanListTerm(t, &rightTerm)) {
+				ListExpressionNode* op = nullptr;
+				if (operatorType == TokenType::PLUS) {
+					op = new LIST_ELEMENT_ADD(leftTerm, rightTerm);
+				}
+				else {
+					op = new LIST_ELEMENT_SUBTRACT(leftTerm, rightTerm);
+				}
+				REGISTER_PTR(op, *outNode);
+				leftTerm = op;
+			}
+			else {
+				SyntaxError(tokenizer, t, "Expected list term");
+				return false;
+			}
+		}
+		return true;
+	}
+	return false;
+}
+
+bool Parser::ScanListTerm(Token t, ListExpressionNode** outNode)
 {
-	TreeNode* id = nullptr;
+	ListExpressionNode* leftOperand = nullptr;
+	if (ScanListOperand(t, &leftOperand)) {
+		*outNode = leftOperand;
+
+		ListExpressionNode* rightOperand = nullptr;
+		while (tokenizer.PeekNextToken(t) && t.type == TokenType::MULTIPLY)
+		{
+			tokenizer.ConsumeNext(); // Need to consume next since PeekNextToken doesn't consume.
+			if (tokenizer.GetNextToken(t) && ScanListOperand(t, &rightOperand)) {
+				ListExpressionNode* op = new LIST_ELEMENT_MULT(leftOperand, rightOperand);
+				REGISTER_PTR(op, *outNode);
+				leftOperand = op;
+			}
+			else {
+				SyntaxError(tokenizer, t, "Expected list operand");
+				return false;
+			}
+		}
+		return true;
+	}
+	return false;
+}
+
+bool Parser::ScanListOperand(Token t, ListExpressionNode** outNode)
+{
+	ID* id = nullptr;
+	if (IsKeywordBeforeValue(t, "abs"))
+	{
+		ListExpressionNode* arg = nullptr;
+		if (tokenizer.GetNextToken(t) && ScanListOperand(t, &arg))
+		{
+			REGISTER_PTR(new LIST_ABS(arg), *outNode);
+			return true;
+		}
+		SyntaxError(tokenizer, t, "Expected list operand");
+	}
+	else if (ScanID(t, &id)) {
+		int listSlot = GetListSlot(id);
+		if (listSlot < 0)
+		{
+			SyntaxError(tokenizer, t, "Using undeclared list : " + id->str);
+		}
+		REGISTER_PTR(new LIST_ID(id, listSlot), *outNode);
+		return true;
+	}
+	else if (t.type == TokenType::LPAREN)
+	{
+		if (tokenizer.GetNextToken(t) && !ScanListExpression(t, outNode))
+		{
+			SyntaxError(tokenizer, t, "Expected list expression");
+			return false;
+		}
+
+		if (tokenizer.GetNextToken(t) && t.type != TokenType::RPAREN)
+		{
+			SyntaxError(tokenizer, t, "Expected ')'");
+			return false;
+		}
+
+		return true;
+	}
+	return false;
+}
+
+bool Parser::ScanAssignment(Token t, StatementNode** outNode)
+{
+	ID* id = nullptr;
 	if(ScanID(t, &id)) {
 		if (!tokenizer.GetNextToken(t)) {
 			SyntaxError(tokenizer, t, "Expected more tokens after ID assignment");
 		}
 
+		int assignedListSlot = GetListSlot(id);
+		if (t.type == TokenType::EQUALS && assignedListSlot >= 0) {
+			ListExpressionNode* expression = nullptr;
+			if (tokenizer.GetNextToken(t) && ScanListExpression(t, &expression)) {
+				REGISTER_PTR(new LIST_ASSIGN(id, assignedListSlot, expression), *outNode);
+				return true;
+			}
+			SyntaxError(tokenizer, t, "Expected list expression for list assignment");
+		}
+
 		if (t.type == TokenType::EQUALS) {
-			TreeNode* expression = nullptr;
+			ExpressionNode* expression = nullptr;
 			if (tokenizer.GetNextToken(t) && (ScanExpression(t, &expression) || ScanString(t, &expression))) {
-				REGISTER_PTR(new EQUALS(id, expression), *outNode);
+				// 'id = id + a + b' is parsed as ((id + a) + b), unwind the ADD chain and append in place if it starts with 'id'.
+				std::string id_name = id->str;
+				std::vector<ExpressionNode*> appended;
+				ExpressionNode* leftmost = expression;
+				while (ADD* add = dynamic_cast<ADD*>(leftmost)) {
+					appended.insert(appended.begin(), add->right);
+					leftmost = add->left;
+				}
+
+				ID* leftmostId = dynamic_cast<ID*>(leftmost);
+				if (leftmostId != nullptr && leftmostId->str == id_name && appended.size() > 0) {
+					REGISTER_PTR(new APPEND(id, appended), *outNode);
+				}
+				else {
+					REGISTER_PTR(new EQUALS(id, expression), *outNode);
+				}
 				return true;
 			}
 			else {
@@ -285,15 +519,26 @@ bool Parser::ScanAssignment(Token t, TreeNode** outNode)
 			}
 		}
 
+		if (t.type == TokenType::PLUS_EQUALS) {
+			ExpressionNode* expression = nullptr;
+			if (tokenizer.GetNextToken(t) && ScanExpression(t, &expression)) {
+				REGISTER_PTR(new APPEND(id, { expression }), *outNode);
+				return true;
+			}
+			else {
+				SyntaxError(tokenizer, t, "Expected expression for '+=' assignment");
+			}
+		}
+
 		// Indexed Assignment
 		if (t.type == TokenType::LBRACKET) {
-			std::string id_name = static_cast<ID*>(id)->str;
-			if (declaredLists.find(id_name) == declaredLists.end())
+			int listSlot = GetListSlot(id);
+			if (listSlot < 0)
 			{
-				SyntaxError(tokenizer, t, "Using undeclared list : " + id_name);
+				SyntaxError(tokenizer, t, "Using undeclared list : " + id->str);
 			}
 
-			TreeNode* index = nullptr;
+			ExpressionNode* index = nullptr;
 			if (!(tokenizer.GetNextToken(t) && ScanExpression(t, &index))) {
 				SyntaxError(tokenizer, t, "Expected index expression for assignment");
 				return false;
@@ -309,9 +554,9 @@ bool Parser::ScanAssignment(Token t, TreeNode** outNode)
 				return false;
 			}
 
-			TreeNode* expression = nullptr;
+			ExpressionNode* expression = nullptr;
 			if (tokenizer.GetNextToken(t) && ScanExpression(t, &expression)) {
-				REGISTER_PTR(new EQUALS_INDEXED(id, index, expression), *outNode);
+				REGISTER_PTR(new EQUALS_INDEXED(id, listSlot, index, expression), *outNode);
 				return true;
 			}
 			else {
@@ -322,15 +567,15 @@ bool Parser::ScanAssignment(Token t, TreeNode** outNode)
 
 		// ListAssignment
 		if (t.type == TokenType::LIST_ADD) {
-			std::string id_name = static_cast<ID*>(id)->str;
-			if (declaredLists.find(id_name) == declaredLists.end())
+			int listSlot = GetListSlot(id);
+			if (listSlot < 0)
 			{
-				SyntaxError(tokenizer, t, "Using undeclared list : " + id_name);
+				SyntaxError(tokenizer, t, "Using undeclared list : " + id->str);
 			}
 
-			TreeNode* expression = nullptr;
+			ExpressionNode* expression = nullptr;
 			if (tokenizer.GetNextToken(t) && ScanExpression(t, &expression)) {
-				REGISTER_PTR(new LIST_ADD(id, expression), *outNode);
+				REGISTER_PTR(new LIST_ADD(id, listSlot, expression), *outNode);
 				return true;
 			}
 			else {
@@ -343,7 +588,7 @@ bool Parser::ScanAssignment(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanListDeclaration(Token t, TreeNode** outNode)
+bool Parser::ScanListDeclaration(Token t, StatementNode** outNode)
 {
 	if (t.type == TokenType::LIST_SORTED || t.type == TokenType::LIST_UNSORTED)
 	{
@@ -366,16 +611,9 @@ bool Parser::ScanListDeclaration(Token t, TreeNode** outNode)
 				SyntaxError(tokenizer, t, "Expected 'list' keyword");
 			}
 
-			TreeNode* id = nullptr;
+			ID* id = nullptr;
 			if (tokenizer.GetNextToken(t) && ScanID(t, &id)) {
-				std::string id_name = static_cast<ID*>(id)->str;
-				if (declaredLists.find(id_name) != declaredLists.end())
-				{
-					SyntaxError(tokenizer, t, "Duplicate List declarations! : " + id_name);
-				}
-
-				declaredLists[id_name] = 0;
-				REGISTER_PTR(new LIST_CREATE(id, isSorted, varType), *outNode);
+				*outNode = DeclareList(t, id, isSorted, varType);
 				return true;
 			}
 			SyntaxError(tokenizer, t, "Expected variable name for list declaration");
@@ -385,7 +623,74 @@ bool Parser::ScanListDeclaration(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanID(Token t, TreeNode** outNode)
+LIST_CREATE* Parser::DeclareList(Token t, ID* id, bool isSorted, VariableType type)
+{
+	std::string id_name = id->str;
+	if (declaredLists.find(id_name) != declaredLists.end())
+	{
+		SyntaxError(tokenizer, t, "Duplicate List declarations! : " + id_name);
+	}
+
+	int listSlot = static_cast<int>(declaredLists.size());
+	declaredLists[id_name] = listSlot;
+	LIST_CREATE* create = nullptr;
+	REGISTER_PTR(new LIST_CREATE(id, listSlot, isSorted, type), create);
+	return create;
+}
+
+// 'into [sorted | unsorted] INTEGER list', lists loaded from text are always INTEGER lists.
+bool Parser::ScanLoadInto(Token t, bool& isSorted)
+{
+	if (t.type == TokenType::LOAD_INTO)
+	{
+		isSorted = false;
+		if (tokenizer.GetNextToken(t) && (t.type == TokenType::LIST_SORTED || t.type == TokenType::LIST_UNSORTED)) {
+			isSorted = t.type == TokenType::LIST_SORTED;
+			tokenizer.GetNextToken(t);
+		}
+
+		if (t.type != TokenType::TYPE_INTEGER) {
+			SyntaxError(tokenizer, t, "Only INTEGER lists can be loaded from text");
+		}
+
+		if (!(tokenizer.GetNextToken(t) && t.type == TokenType::LIST)) {
+			SyntaxError(tokenizer, t, "Expected 'list' keyword");
+		}
+		return true;
+	}
+	return false;
+}
+
+bool Parser::ScanSort(Token t, StatementNode** outNode)
+{
+	if (t.type == TokenType::LIST_SORT)
+	{
+		ID* id = nullptr;
+		if (tokenizer.GetNextToken(t) && ScanID(t, &id)) {
+			int listSlot = GetListSlot(id);
+			if (listSlot < 0)
+			{
+				SyntaxError(tokenizer, t, "Using undeclared list : " + id->str);
+			}
+			REGISTER_PTR(new LIST_SORT(id, listSlot), *outNode);
+			return true;
+		}
+		SyntaxError(tokenizer, t, "Expected list to sort");
+	}
+	return false;
+}
+
+// The words of the list reductions and searches, e.g. 'count' and 'sum', are only keywords when a value follows them,
+// since scripts use them as variable names as well.
+bool Parser::IsKeywordBeforeValue(Token t, const char* keyword)
+{
+	Token next;
+	return t.type == TokenType::ID && t.value == keyword && tokenizer.PeekNextToken(next)
+		&& (next.type == TokenType::ID || next.type == TokenType::INTEGER || next.type == TokenType::STRING || next.type == TokenType::LPAREN
+			|| next.type == TokenType::LINE || next.type == TokenType::CHAR);
+}
+
+bool Parser::ScanID(Token t, ID** outNode)
 {
 	if (t.type == TokenType::ID) {
 		REGISTER_PTR(new ID(t.value), *outNode);
@@ -402,30 +707,65 @@ bool Parser::ScanID(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanPrint(Token t, TreeNode** outNode)
+int Parser::GetListSlot(ID* id)
 {
-	if (t.type == TokenType::PRINT) {
-		TreeNode* id;
-		if (tokenizer.GetNextToken(t) && ScanID(t, &id)) {
-			REGISTER_PTR(new PRINT_ID(id), *outNode);
-			return true;
-		}
-		else if (ScanString(t, &id)) {
-			REGISTER_PTR(new PRINT_STR(id), *outNode);
-			return true;
+	auto found = declaredLists.find(id->str);
+	if (found == declaredLists.end())
+	{
+		return -1;
+	}
+	return found->second;
+}
+
+bool Parser::ScanPrint(Token t, StatementNode** outNode)
+{
+	PrintLevel level;
+	switch (t.type)
+	{
+	case TokenType::PRINT: level = PrintLevel::PRINT; break;
+	case TokenType::PRINT_DEBUG: level = PrintLevel::DEBUG; break;
+	case TokenType::PRINT_TRACE: level = PrintLevel::TRACE; break;
+	default: return false;
+	}
+
+	ID* id;
+	ExpressionNode* str;
+	if (tokenizer.GetNextToken(t) && ScanID(t, &id)) {
+		int listSlot = GetListSlot(id);
+		if (listSlot >= 0) {
+			REGISTER_PTR(new PRINT_LIST(id, listSlot, level), *outNode);
 		}
-		else if (t.type == TokenType::DAY) {
-			REGISTER_PTR(new PRINT_DAY(), *outNode);
-			return true;
-		} 
 		else {
-			SyntaxError(tokenizer, t, "Expected identifier or string or DAY");
+			REGISTER_PTR(new PRINT_ID(id, level), *outNode);
 		}
+		return true;
+	}
+	else if (ScanString(t, &str)) {
+		REGISTER_PTR(new PRINT_STR(str, level), *outNode);
+		return true;
+	}
+	else if (t.type == TokenType::DAY) {
+		REGISTER_PTR(new PRINT_DAY(level), *outNode);
+		return true;
+	} 
+	else {
+		SyntaxError(tokenizer, t, "Expected identifier or string or DAY");
 	}
 	return false;
 }
 
-bool Parser::ScanBreak(Token t, TreeNode** outNode)
+bool Parser::ScanParallel(Token t, StatementNode** outNode)
+{
+	if (t.type == TokenType::PARALLEL) {
+		if (!(tokenizer.GetNextToken(t) && ScanLoop(t, outNode, true))) {
+			SyntaxError(tokenizer, t, "Expected loop after 'parallel'");
+		}
+		return true;
+	}
+	return false;
+}
+
+bool Parser::ScanBreak(Token t, StatementNode** outNode)
 {
 	if (t.type == TokenType::LOOP_BREAK) {
 		REGISTER_PTR(new BREAK(), *outNode);
@@ -434,7 +774,7 @@ bool Parser::ScanBreak(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanString(Token t, TreeNode** outNode)
+bool Parser::ScanString(Token t, ExpressionNode** outNode)
 {
 	if (t.type == TokenType::STRING) {
 		std::string str = t.value.substr(1, t.value.length() - 2);
@@ -444,10 +784,36 @@ bool Parser::ScanString(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanLoad(Token t, TreeNode** outNode)
+bool Parser::ScanLoad(Token t, StatementNode** outNode)
 {
 	if (t.type == TokenType::LOAD) {
-		TreeNode* str;
+		Token next;
+		if (tokenizer.PeekNextToken(next) && next.type == TokenType::LOAD_COLUMNS) {
+			tokenizer.ConsumeNext();
+			ExpressionNode* str = nullptr;
+			if (!(tokenizer.GetNextToken(t) && ScanString(t, &str))) {
+				SyntaxError(tokenizer, t, "Expected string");
+			}
+
+			bool isSorted = false;
+			if (!(tokenizer.GetNextToken(t) && ScanLoadInto(t, isSorted))) {
+				SyntaxError(tokenizer, t, "Expected 'into'");
+			}
+
+			std::vector<LIST_CREATE*> columns;
+			do {
+				ID* id = nullptr;
+				if (!(tokenizer.GetNextToken(t) && ScanID(t, &id))) {
+					SyntaxError(tokenizer, t, "Expected list name for column");
+				}
+				columns.push_back(DeclareList(t, id, isSorted, VariableType::INTEGER));
+			} while (tokenizer.PeekNextToken(t) && t.type == TokenType::COMMA && tokenizer.ConsumeNext());
+
+			REGISTER_PTR(new LOAD_COLUMNS(str, columns), *outNode);
+			return true;
+		}
+
+		ExpressionNode* str;
 		if (tokenizer.GetNextToken(t) && ScanString(t, &str)) {
 			REGISTER_PTR(new LOAD(str), *outNode);
 			return true;
@@ -459,19 +825,19 @@ bool Parser::ScanLoad(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanIf(Token t, TreeNode** outNode)
+bool Parser::ScanIf(Token t, StatementNode** outNode)
 {
 	if (t.type == TokenType::IF) {
-		TreeNode* condition;
+		ExpressionNode* condition;
 		if (tokenizer.GetNextToken(t) && ScanExpression(t, &condition)) {
 			if (!(tokenizer.GetNextToken(t) && t.type == TokenType::COLON)) {
 				SyntaxError(tokenizer, t, "Expected colon ':'");
 				return false;
 			}
 			
-			std::vector<TreeNode*> statements;
+			std::vector<StatementNode*> statements;
 			{
-				TreeNode* statement = nullptr;
+				StatementNode* statement = nullptr;
 				while (tokenizer.GetNextToken(t) && ScanStatement(t, &statement, false)) {
 					statements.push_back(statement);
 				} // Will end on GetNextToken being called and ScanExpression failing, don't have to call get next token again.
@@ -487,9 +853,9 @@ bool Parser::ScanIf(Token t, TreeNode** outNode)
 				return false;
 			}
 
-			std::vector<TreeNode*> else_statements;
+			std::vector<StatementNode*> else_statements;
 			{
-				TreeNode* else_statement = nullptr;
+				StatementNode* else_statement = nullptr;
 				while (tokenizer.GetNextToken(t) && ScanStatement(t, &else_statement, false)) {
 					else_statements.push_back(else_statement);
 				} // Will end on GetNextToken being called and ScanExpression failing, don't have to call get next token again.
@@ -511,14 +877,14 @@ bool Parser::ScanIf(Token t, TreeNode** outNode)
 }
 
 
-bool Parser::ScanLoop(Token t, TreeNode** outNode)
+bool Parser::ScanLoop(Token t, StatementNode** outNode, bool parallel)
 {
 	if (t.type == TokenType::LOOP) {
 		if (!tokenizer.GetNextToken(t)) {
 			SyntaxError(tokenizer, t, "loop requires an iterator or an expression");
 		}
 
-		TreeNode* id = nullptr;
+		ID* id = nullptr;
 		Token nextToken;
 		if (t.type != TokenType::CHAR 
 			&& (ScanID(t, &id) && tokenizer.PeekNextToken(nextToken) && nextToken.type == TokenType::LOOP_CHARS)) {
@@ -532,9 +898,9 @@ bool Parser::ScanLoop(Token t, TreeNode** outNode)
 				return false;
 			}
 
-			std::vector<TreeNode*> statements;
+			std::vector<StatementNode*> statements;
 			{
-				TreeNode* statement = nullptr;
+				StatementNode* statement = nullptr;
 				while (tokenizer.GetNextToken(t) && ScanStatement(t, &statement, false)) {
 					statements.push_back(statement);
 				} // Will end on GetNextToken being called and ScanExpression failing, don't have to call get next token again.
@@ -545,7 +911,17 @@ bool Parser::ScanLoop(Token t, TreeNode** outNode)
 				return false;
 			}
 
-			REGISTER_PTR(new LOOP_ITERATOR(id, statements), *outNode);
+			if (parallel) {
+				SyntaxError(tokenizer, t, "Only DAY loops can run in parallel");
+			}
+
+			int listSlot = GetListSlot(id);
+			if (listSlot >= 0) {
+				REGISTER_PTR(new LOOP_LIST(id, listSlot, statements), *outNode);
+			}
+			else {
+				REGISTER_PTR(new LOOP_ITERATOR(id, statements), *outNode);
+			}
 			return true;
 		}
 
@@ -555,7 +931,7 @@ bool Parser::ScanLoop(Token t, TreeNode** outNode)
 			id = nullptr;
 		}
 
-		TreeNode* times = id;
+		ExpressionNode* times = id;
 		if (ScanExpression(t, &times)) {
 			if (!(tokenizer.GetNextToken(t) && t.type == TokenType::LOOP_TIMES)) {
 				SyntaxError(tokenizer, t, "Expected 'times'");
@@ -567,9 +943,9 @@ bool Parser::ScanLoop(Token t, TreeNode** outNode)
 				return false;
 			}
 
-			std::vector<TreeNode*> statements;
+			std::vector<StatementNode*> statements;
 			{
-				TreeNode* statement = nullptr;
+				StatementNode* statement = nullptr;
 				while (tokenizer.GetNextToken(t) && ScanStatement(t, &statement, false)) {
 					statements.push_back(statement);
 				} // Will end on GetNextToken being called and ScanExpression failing, don't have to call get next token again.
@@ -580,24 +956,74 @@ bool Parser::ScanLoop(Token t, TreeNode** outNode)
 				return false;
 			}
 
+			if (parallel) {
+				SyntaxError(tokenizer, t, "Only DAY loops can run in parallel");
+			}
+
 			REGISTER_PTR(new LOOP(times, statements), *outNode);
 			return true;
 		}
 		
 		if (t.type == TokenType::DAY) {
-			if (!(tokenizer.GetNextToken(t) && t.type == TokenType::LOOP_LINES)) {
-				SyntaxError(tokenizer, t, "Expected 'lines'");
+			LIST_CREATE* row = nullptr;
+			if (!(tokenizer.GetNextToken(t) && (t.type == TokenType::LOOP_LINES || t.type == TokenType::LOOP_ROWS))) {
+				SyntaxError(tokenizer, t, "Expected 'lines' or 'rows'");
 				return false;
 			}
+			else if (t.type == TokenType::LOOP_ROWS) {
+				bool isSorted = false;
+				if (!(tokenizer.GetNextToken(t) && ScanLoadInto(t, isSorted))) {
+					SyntaxError(tokenizer, t, "Expected 'into'");
+				}
+
+				ID* id = nullptr;
+				if (!(tokenizer.GetNextToken(t) && ScanID(t, &id))) {
+					SyntaxError(tokenizer, t, "Expected list name for rows");
+				}
+				row = DeclareList(t, id, isSorted, VariableType::INTEGER);
+			}
+
+			std::vector<LoopReduction> reductions;
+			if (parallel && tokenizer.PeekNextToken(t) && t.type == TokenType::LOOP_REDUCE) {
+				tokenizer.ConsumeNext();
+				do {
+					LoopReduction reduction;
+					if (!(tokenizer.GetNextToken(t) && ScanID(t, &reduction.id))) {
+						SyntaxError(tokenizer, t, "Expected variable or list to reduce");
+					}
+					reduction.listSlot = GetListSlot(reduction.id);
+
+					if (!tokenizer.GetNextToken(t)) {
+						SyntaxError(tokenizer, t, "Expected reduction 'sum', 'min', 'max' or 'concat'");
+					}
+					else if (t.type == TokenType::ID && t.value == "concat") {
+						if (reduction.listSlot < 0) {
+							SyntaxError(tokenizer, t, "Using undeclared list : " + reduction.id->str);
+						}
+						reduction.op = LoopReduction::Operator::CONCAT;
+					}
+					else if (t.type == TokenType::ID && (t.value == "sum" || t.value == "min" || t.value == "max")) {
+						if (reduction.listSlot >= 0) {
+							SyntaxError(tokenizer, t, "Lists can only be reduced with 'concat' : " + reduction.id->str);
+						}
+						reduction.op = t.value == "sum" ? LoopReduction::Operator::SUM
+							: t.value == "min" ? LoopReduction::Operator::MIN : LoopReduction::Operator::MAX;
+					}
+					else {
+						SyntaxError(tokenizer, t, "Expected reduction 'sum', 'min', 'max' or 'concat'");
+					}
+					reductions.push_back(reduction);
+				} while (tokenizer.PeekNextToken(t) && t.type == TokenType::COMMA && tokenizer.ConsumeNext());
+			}
 
 			if (!(tokenizer.GetNextToken(t) && t.type == TokenType::COLON)) {
 				SyntaxError(tokenizer, t, "Expected colon ':'");
 				return false;
 			}
 
-			std::vector<TreeNode*> statements;
+			std::vector<StatementNode*> statements;
 			{
-				TreeNode* statement = nullptr;
+				StatementNode* statement = nullptr;
 				while (tokenizer.GetNextToken(t) && ScanStatement(t, &statement, false)) {
 					statements.push_back(statement);
 				} // Will end on GetNextToken being called and ScanExpression failing, don't have to call get next token again.
@@ -608,7 +1034,20 @@ bool Parser::ScanLoop(Token t, TreeNode** outNode)
 				return false;
 			}
 
-			REGISTER_PTR(new LOOP_DAY(statements), *outNode);
+			LOOP_DAY* dayLoop = nullptr;
+			if (row != nullptr) {
+				REGISTER_PTR(new LOOP_DAY_ROWS(row, statements), dayLoop);
+			}
+			else {
+				REGISTER_PTR(new LOOP_DAY(statements), dayLoop);
+			}
+
+			if (parallel) {
+				REGISTER_PTR(new PARALLEL_LOOP_DAY(dayLoop, reductions), *outNode);
+			}
+			else {
+				*outNode = dayLoop;
+			}
 			return true;
 		}
 
@@ -617,17 +1056,17 @@ bool Parser::ScanLoop(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanAssert(Token t, TreeNode** outNode)
+bool Parser::ScanAssert(Token t, StatementNode** outNode)
 {
 	if (t.type == TokenType::ASSERT) {
-		TreeNode* condition;
+		ExpressionNode* condition;
 		if (tokenizer.GetNextToken(t) && ScanExpression(t, &condition)) {
 			if (!(tokenizer.GetNextToken(t) && t.type == TokenType::COLON)) {
 				SyntaxError(tokenizer, t, "Expected colon ':'");
 				return false;
 			}
 
-			TreeNode* str;
+			ExpressionNode* str;
 			if (tokenizer.GetNextToken(t) && ScanString(t, &str)) {
 				REGISTER_PTR(new ASSERT(condition, str), *outNode);
 				return true;
@@ -643,20 +1082,28 @@ bool Parser::ScanAssert(Token t, TreeNode** outNode)
 	return false;
 }
 
-bool Parser::ScanStatement(Token t, TreeNode** outNode, bool programStatement)
+bool Parser::ScanStatement(Token t, StatementNode** outNode, bool programStatement)
 {
-	TreeNode* statement = nullptr;
+	int line = t.line;
+	std::string source = tokenizer.GetLastLine();
+	// Loops and loads are on the --trace timeline at any depth, other statements only at the top level.
+	bool traced = programStatement || t.type == TokenType::LOAD || t.type == TokenType::LOOP || t.type == TokenType::PARALLEL;
+	StatementNode* statement = nullptr;
 	if (ScanAssignment(t, &statement) 
 		|| ScanPrint(t, &statement) 
 		|| ScanLoad(t, &statement) 
 		|| ScanIf(t, &statement) 
 		|| ScanLoop(t, &statement)
+		|| ScanParallel(t, &statement)
 		|| ScanAssert(t, &statement)
 		|| ScanListDeclaration(t, &statement)
+		|| ScanSort(t, &statement)
 		|| ScanBreak(t, &statement)
 		) {
 		if (tokenizer.GetNextToken(t) && t.type == TokenType::SEMICOLON) {
-			REGISTER_PTR(new Statement(statement), *outNode);
+			// Only the reports name statements by their id, a resident server or --watch parses scripts again and again.
+			int profileId = Profiler::enabled || Trace::enabled || PerfCounters::enabled ? Profiler::Register(line, source) : -1;
+			REGISTER_PTR(new Statement(statement, line, profileId, traced), *outNode);
 			return true;
 		}
 		else {
@@ -669,22 +1116,25 @@ bool Parser::ScanStatement(Token t, TreeNode** outNode, bool programStatement)
 
 Parser::Parser(std::string code, bool printSyntax) : tokenizer(code), ast(nullptr)
 {
-	Token t;
-	TreeNode* statement;
+	StatsPhaseScope phase(StatPhase::PARSE);
+	StatementNode* statement;
+	Optimizer optimizer(nodes);
 	bool success = true;
 	try {
-		while (tokenizer.GetNextToken(t) && ScanStatement(t, &statement))
+		while (ScanProgramStatement(optimizer, &statement))
 		{
-			statements.push_back(statement);
 			PushConsoleColor(CONSOLE_COLOR::YELLOW);
 			if (printSyntax) { std::cout << "\t\t"; statement->print(); }
 			PopConsoleColor();
-			statement->eval(&globals);
-		}
-		if (t.type != TokenType::END) {
-			SyntaxError(tokenizer, t, "Expected no more statements but received more.");
+			if (optimizer.IsRemoved(statement)) {
+				continue;
+			}
+			StatsPhaseScope execute(StatPhase::EXECUTE);
+			PerfStatementScope counters(static_cast<Statement*>(statement)->profileId);
+			statement->exec(&globals);
+			globals.output->flush();
 		}
-
+		tokenizer.CacheTokens();
 	}
 	catch (const std::invalid_argument& e) {
 		success = false;
@@ -695,6 +1145,56 @@ Parser::Parser(std::string code, bool printSyntax) : tokenizer(code), ast(nullpt
 	}
 }
 
+Parser::Parser(std::string code) : tokenizer(code), ast(nullptr)
+{
+	StatsPhaseScope phase(StatPhase::PARSE);
+	StatementNode* statement;
+	Optimizer optimizer(nodes);
+	while (ScanProgramStatement(optimizer, &statement))
+	{
+	}
+	tokenizer.CacheTokens();
+}
+
+bool Parser::ScanProgramStatement(Optimizer& optimizer, StatementNode** outNode)
+{
+	Token t;
+	tokenizer.ResetHash();
+	if (tokenizer.GetNextToken(t) && ScanStatement(t, outNode)) {
+		optimizer.Optimize(*outNode);
+		if (!optimizer.IsRemoved(*outNode)) {
+			statements.push_back(*outNode);
+			statementHashes.push_back(tokenizer.GetHash());
+		}
+		return true;
+	}
+	if (t.type != TokenType::END) {
+		SyntaxError(tokenizer, t, "Expected no more statements but received more.");
+	}
+	return false;
+}
+
+void Parser::Run(RuntimeGlobals* runGlobals)
+{
+	StatsPhaseScope phase(StatPhase::EXECUTE);
+	for (size_t i = 0; i < statements.size(); i++)
+	{
+		RunStatement(i, runGlobals);
+	}
+}
+
+int Parser::StatementLine(size_t index) const
+{
+	return static_cast<Statement*>(statements[index])->line;
+}
+
+void Parser::RunStatement(size_t index, RuntimeGlobals* runGlobals)
+{
+	PerfStatementScope counters(static_cast<Statement*>(statements[index])->profileId);
+	statements[index]->exec(runGlobals);
+	runGlobals->output->flush();
+}
+
 Parser::~Parser()
 {
 	for (TreeNode* node : nodes)
@@ -703,31 +1203,113 @@ Parser::~Parser()
 	}
 }
 
-void LOAD::eval(RuntimeGlobals* globals)
+void LOAD::exec(RuntimeGlobals* globals)
 {
-	str->eval(globals);
-	globals->DayFileName = globals->pop_var().strValue;
-	if (!ReadFile(globals->DayFileName, globals->DayString))
+	Stats::CountNode("LOAD");
+	globals->DayFileName = globals->ResolvePath(globals->InputFileName.empty() ? str->evaluate(globals).GetString().str() : globals->InputFileName);
+	std::shared_ptr<const LoadedInput> input = InputCache::Load(globals->DayFileName);
+	if (input == nullptr)
 	{
 		RuntimeError("Could not load Day input from file {" + globals->DayFileName + "}");
 	}
-	
-	auto splitByLines = [](const std::string& input, std::vector<std::string>& outLines) {
-		outLines.clear();
-		std::istringstream stream(input);
-		std::string line;
+	globals->DayInput = input;
+	if (globals->loadedFiles != nullptr) {
+		globals->loadedFiles->push_back(globals->DayFileName);
+	}
+}
+
+void LOAD_COLUMNS::exec(RuntimeGlobals* globals)
+{
+	Stats::CountNode("LOAD_COLUMNS");
+	std::string fileName = globals->ResolvePath(globals->InputFileName.empty() ? str->evaluate(globals).GetString().str() : globals->InputFileName);
+	std::string contents;
+	ReadFile(fileName, contents);
+	if (globals->loadedFiles != nullptr) {
+		globals->loadedFiles->push_back(fileName);
+	}
 
-		while (std::getline(stream, line)) {
-			outLines.push_back(line); // Add each line to the vector
+	// The integers are written straight into the list storage, sorted lists sort them in bulk when they are first read.
+	std::vector<List*> lists;
+	for (LIST_CREATE* column : columns)
+	{
+		column->exec(globals);
+		lists.push_back(globals->get_unsettled_list(column->listSlot, column->id->str));
+	}
+
+	std::vector<int> row;
+	const char* cursor = contents.data();
+	const char* end = cursor + contents.size();
+	int lineNumber = 0;
+	while (cursor < end)
+	{
+		++lineNumber;
+		row.clear();
+		if (!NumberScanner::ScanLine(cursor, end, row)) {
+			RuntimeError("Expected only integers on line " + std::to_string(lineNumber) + " of {" + fileName + "}");
 		}
-	};
-	splitByLines(globals->DayString, globals->DayLines);
+
+		if (row.empty()) {
+			continue;
+		}
+
+		if (row.size() != lists.size()) {
+			RuntimeError("Line " + std::to_string(lineNumber) + " of {" + fileName + "} has " + std::to_string(row.size())
+				+ " columns, expected " + std::to_string(lists.size()));
+		}
+
+		for (size_t column = 0; column < lists.size(); column++)
+		{
+			lists[column]->ints.push_back(row[column]);
+		}
+	}
 }
 
-void CAST::eval(RuntimeGlobals* globals) {
-	left->eval(globals);
-	StackVariable var = globals->pop_var();
-	StackVariable result = var;
+void LOOP_DAY_ROWS::beginLine(RuntimeGlobals* globals, StringRef line, int iter)
+{
+	List* list = globals->get_unsettled_list(row->listSlot, row->id->str);
+	list->clear();
+	const char* cursor = line.data();
+	if (!NumberScanner::ScanLine(cursor, cursor + line.size(), list->ints)) {
+		RuntimeError("Expected only integers on DAY line " + std::to_string(iter + 1));
+	}
+}
+
+void APPEND::exec(RuntimeGlobals* globals)
+{
+	Stats::CountNode("APPEND");
+	// Evaluate all operands before touching the variable, 'a = a + a' must append the old value of 'a'.
+	std::vector<StackVariable> operands;
+	operands.reserve(expressions.size());
+	for (ExpressionNode* expression : expressions)
+	{
+		operands.push_back(expression->evaluate(globals));
+	}
+
+	StackVariable& var = id->get(globals);
+	for (StackVariable& operand : operands)
+	{
+		if (var.type != operand.type) {
+			RuntimeError("Type mismatch: " + VariableTypeToString(var.type) + " + " + VariableTypeToString(operand.type));
+		}
+
+		switch (var.type)
+		{
+		case VariableType::INTEGER:
+			var.intValue += operand.intValue;
+			break;
+		case VariableType::STRING:
+			var.GetMutableString() += operand.GetString(); // std::string grows geometrically, appending is amortized O(1)
+			break;
+		case VariableType::FLOAT:
+			var.fltValue += operand.fltValue;
+			break;
+		}
+	}
+}
+
+StackVariable CAST::evaluate(RuntimeGlobals* globals) {
+	Stats::CountNode("CAST");
+	StackVariable var = left->evaluate(globals);
 
 	VariableType fromType = var.type;
 	VariableType toType = type;
@@ -738,15 +1320,10 @@ void CAST::eval(RuntimeGlobals* globals) {
 	{
 		switch (toType)
 		{
-		case VariableType::INTEGER:
-			globals->push_var(result);
-			break;
 		case VariableType::STRING:
-			globals->push_var(std::to_string(var.intValue));
-			break;
+			return std::to_string(var.intValue);
 		case VariableType::FLOAT:
-			globals->push_var(static_cast<float>(var.intValue));
-			break;
+			return static_cast<float>(var.intValue);
 		default:
 			break;
 		}
@@ -756,14 +1333,9 @@ void CAST::eval(RuntimeGlobals* globals) {
 		switch (toType)
 		{
 		case VariableType::INTEGER:
-			globals->push_var(std::stoi(var.strValue));
-			break;
-		case VariableType::STRING:
-			globals->push_var(var);
-			break;
+			return std::stoi(var.GetString().str());
 		case VariableType::FLOAT:
-			globals->push_var(std::stof(var.strValue));
-			break;
+			return std::stof(var.GetString().str());
 		default:
 			break;
 		}
@@ -773,19 +1345,26 @@ void CAST::eval(RuntimeGlobals* globals) {
 		switch (toType)
 		{
 		case VariableType::INTEGER:
-			globals->push_var(static_cast<int>(var.fltValue));
-			break;
+			return static_cast<int>(var.fltValue);
 		case VariableType::STRING:
-			globals->push_var(std::to_string(var.fltValue));
-			break;
-		case VariableType::FLOAT:
-			globals->push_var(var);
-			break;
+			return std::to_string(var.fltValue);
 		default:
 			break;
 		}
 	}break;
 	}
+
+	// Casting to the same type
+	return var;
+}
+
+// Counts the appends that have to move the elements to larger storage.
+template<typename T>
+static void CountGrowth(const std::vector<T>& vec)
+{
+	if (Stats::enabled && vec.size() == vec.capacity()) {
+		Stats::Count(&StatCounters::listReallocations);
+	}
 }
 
 void List::push_var(StackVariable var)
@@ -793,14 +1372,43 @@ void List::push_var(StackVariable var)
 	if (var.type != type) {
 		RuntimeError("Can't add value of type {" + VariableTypeToString(var.type) + "} to list" + "<" + VariableTypeToString(type) + ">");
 	}
-	list.push_back(var);
+
+	switch (type)
+	{
+	case VariableType::INTEGER:
+		CountGrowth(ints);
+		ints.push_back(var.intValue);
+		break;
+	case VariableType::FLOAT:
+		CountGrowth(floats);
+		floats.push_back(var.fltValue);
+		break;
+	default:
+		CountGrowth(strings);
+		var.DetachLine();
+		strings.push_back(std::move(var));
+		break;
+	}
+	countsValid = false;
 }
 
 StackVariable List::pop_var()
 {
-	if (list.size() == 0) return StackVariable(0);
-	StackVariable result = list.back();
-	list.pop_back();
+	if (size() == 0) return StackVariable(0);
+	StackVariable result = get_var(size() - 1);
+	switch (type)
+	{
+	case VariableType::INTEGER:
+		ints.pop_back();
+		break;
+	case VariableType::FLOAT:
+		floats.pop_back();
+		break;
+	default:
+		strings.pop_back();
+		break;
+	}
+	countsValid = false;
 	return result;
 }
 
@@ -810,47 +1418,289 @@ void List::set_var(int index, StackVariable expressionVar)
 		RuntimeError("Can't add value of type {" + VariableTypeToString(expressionVar.type) + "} to list" + "<" + VariableTypeToString(type) + ">");
 	}
 
-	if (index >= 0 && index < list.size()) {
-		list[index] = expressionVar;
+	if (index >= 0 && static_cast<size_t>(index) < size()) {
+		switch (type)
+		{
+		case VariableType::INTEGER:
+			ints[index] = expressionVar.intValue;
+			break;
+		case VariableType::FLOAT:
+			floats[index] = expressionVar.fltValue;
+			break;
+		default:
+			expressionVar.DetachLine();
+			strings[index] = std::move(expressionVar);
+			break;
+		}
+	}
+	countsValid = false;
+}
+
+void List::assign(const List& other)
+{
+	if (other.type != type) {
+		RuntimeError("Can't assign list<" + VariableTypeToString(other.type) + "> to list<" + VariableTypeToString(type) + ">");
+	}
+
+	if (&other != this) {
+		ints = other.ints;
+		floats = other.floats;
+		strings = other.strings;
 	}
+	countsValid = false;
 }
 
-void SortedList::push_var(StackVariable var)
+void List::clear()
 {
-	if (var.type != type) {
-		RuntimeError("Can't add value of type {" + VariableTypeToString(var.type) + "} to list" + "<" + VariableTypeToString(type) + ">");
+	ints.clear();
+	floats.clear();
+	strings.clear();
+	countsValid = false;
+}
+
+// LSD radix sort, one pass per byte with the sign bit flipped so negative numbers come first.
+// Passes where all elements share the same byte are skipped, small inputs are left to std::sort.
+static void RadixSort(int* values, size_t count)
+{
+	if (count < 256) {
+		std::sort(values, values + count);
+		return;
 	}
 
-	auto insertion_sort = [](std::vector<StackVariable>& vec, StackVariable value) {
-		auto it = std::lower_bound(vec.begin(), vec.end(), value);
-		vec.insert(it, value);
-	};
+	auto key = [](int value) { return static_cast<uint32_t>(value) ^ 0x80000000u; };
+
+	size_t histograms[4][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t valueKey = key(values[i]);
+		for (int pass = 0; pass < 4; pass++)
+		{
+			++histograms[pass][(valueKey >> (pass * 8)) & 0xFF];
+		}
+	}
+
+	std::vector<int> buffer(count);
+	int* source = values;
+	int* destination = buffer.data();
+	for (int pass = 0; pass < 4; pass++)
+	{
+		int shift = pass * 8;
+		size_t* histogram = histograms[pass];
+		if (histogram[(key(source[0]) >> shift) & 0xFF] == count) {
+			continue;
+		}
 
-	insertion_sort(list, var);
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			size_t bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[histogram[(key(source[i]) >> shift) & 0xFF]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+
+	if (source != values) {
+		std::copy(source, source + count, values);
+	}
 }
 
-void SortedList::set_var(int index, StackVariable expressionVar)
+void List::sort()
 {
-	if (expressionVar.type != type) {
-		RuntimeError("Can't add value of type {" + VariableTypeToString(expressionVar.type) + "} to list" + "<" + VariableTypeToString(type) + ">");
+	switch (type)
+	{
+	case VariableType::INTEGER:
+		RadixSort(ints.data(), ints.size());
+		break;
+	case VariableType::FLOAT:
+		std::sort(floats.begin(), floats.end());
+		break;
+	default:
+		std::sort(strings.begin(), strings.end());
+		break;
 	}
+}
 
-	if (index >= 0 && index < list.size()) {
-		list[index] = expressionVar;
+int List::count_var(const StackVariable& value)
+{
+	if (value.type != type) {
+		return 0;
 	}
 
-	std::sort(list.begin(), list.end());
+	if (type == VariableType::FLOAT || is_sorted()) {
+		return count_equal(value);
+	}
+
+	if (!countsValid) {
+		intCounts.clear();
+		stringCounts.clear();
+		for (int intValue : ints)
+		{
+			++intCounts[intValue];
+		}
+		for (const StackVariable& var : strings)
+		{
+			++stringCounts[var.GetString().str()];
+		}
+		countsValid = true;
+	}
+
+	if (type == VariableType::INTEGER) {
+		auto found = intCounts.find(value.intValue);
+		return found != intCounts.end() ? found->second : 0;
+	}
+
+	// Only an interned string or a line is copied to look it up.
+	auto found = value.shared == nullptr ? stringCounts.find(value.strValue) : stringCounts.find(value.GetString().str());
+	return found != stringCounts.end() ? found->second : 0;
 }
 
-void RuntimeGlobals::push_var(StackVariable var)
+static bool ElementEquals(int a, int b) { return a == b; }
+static bool ElementEquals(float a, float b) { return a == b; }
+static bool ElementEquals(const StackVariable& a, const StackVariable& b) { return a.StringEquals(b); }
+
+// Calls search with the typed storage of the list and the value unboxed to match it.
+template<typename Search>
+static int SearchList(const List& list, const StackVariable& value, Search search)
 {
-	stack.push_back(var);
+	switch (list.type)
+	{
+	case VariableType::INTEGER:
+		return search(list.ints, value.intValue);
+	case VariableType::FLOAT:
+		return search(list.floats, value.fltValue);
+	default:
+		return search(list.strings, value);
+	}
 }
 
-StackVariable RuntimeGlobals::pop_var()
+int List::count_equal(const StackVariable& value) const
 {
-	if (stack.size() == 0) return StackVariable(0);
-	StackVariable result = stack.back();
-	stack.pop_back();
-	return result;
+	bool sorted = is_sorted();
+	return SearchList(*this, value, [sorted](const auto& vec, const auto& element) {
+		if (sorted) {
+			auto range = std::equal_range(vec.begin(), vec.end(), element);
+			return static_cast<int>(range.second - range.first);
+		}
+		return static_cast<int>(std::count_if(vec.begin(), vec.end(), [&element](const auto& other) { return ElementEquals(other, element); }));
+	});
+}
+
+int List::find_index(const StackVariable& value) const
+{
+	bool sorted = is_sorted();
+	return SearchList(*this, value, [sorted](const auto& vec, const auto& element) {
+		auto found = vec.end();
+		if (sorted) {
+			found = std::lower_bound(vec.begin(), vec.end(), element);
+			if (found != vec.end() && !ElementEquals(*found, element)) {
+				found = vec.end();
+			}
+		}
+		else {
+			found = std::find_if(vec.begin(), vec.end(), [&element](const auto& other) { return ElementEquals(other, element); });
+		}
+		return found != vec.end() ? static_cast<int>(found - vec.begin()) : -1;
+	});
+}
+
+int List::lower_bound(const StackVariable& value) const
+{
+	bool sorted = is_sorted();
+	return SearchList(*this, value, [sorted](const auto& vec, const auto& element) {
+		if (sorted) {
+			return static_cast<int>(std::lower_bound(vec.begin(), vec.end(), element) - vec.begin());
+		}
+		return static_cast<int>(std::count_if(vec.begin(), vec.end(), [&element](const auto& other) { return other < element; }));
+	});
+}
+
+void SortedList::push_var(StackVariable var)
+{
+	Stats::Count(&StatCounters::sortedInserts);
+	// Appending keeps the sorted prefix as long as the elements arrive in order.
+	bool settled = sortedCount == size();
+	List::push_var(std::move(var));
+
+	auto inOrder = [](const auto& vec) {
+		return vec.size() < 2 || !(vec[vec.size() - 1] < vec[vec.size() - 2]);
+	};
+
+	if (settled) {
+		switch (type)
+		{
+		case VariableType::INTEGER:
+			settled = inOrder(ints);
+			break;
+		case VariableType::FLOAT:
+			settled = inOrder(floats);
+			break;
+		default:
+			settled = inOrder(strings);
+			break;
+		}
+	}
+
+	if (settled) {
+		sortedCount = size();
+	}
+}
+
+void SortedList::set_var(int index, StackVariable expressionVar)
+{
+	List::set_var(index, std::move(expressionVar));
+	sort();
+}
+
+void SortedList::assign(const List& other)
+{
+	List::assign(other);
+	sort();
+}
+
+void SortedList::clear()
+{
+	List::clear();
+	sortedCount = 0;
+}
+
+void SortedList::sort()
+{
+	Stats::Count(&StatCounters::sortedResorts);
+	List::sort();
+	sortedCount = size();
+}
+
+void SortedList::settle()
+{
+	if (sortedCount == size()) {
+		return;
+	}
+	Stats::Count(&StatCounters::sortedResorts);
+
+	// Sort only the pending elements and merge them into the sorted prefix.
+	auto sortPending = [this](auto& vec) {
+		std::sort(vec.begin() + sortedCount, vec.end());
+		std::inplace_merge(vec.begin(), vec.begin() + sortedCount, vec.end());
+	};
+
+	switch (type)
+	{
+	case VariableType::INTEGER:
+		RadixSort(ints.data() + sortedCount, ints.size() - sortedCount);
+		std::inplace_merge(ints.begin(), ints.begin() + sortedCount, ints.end());
+		break;
+	case VariableType::FLOAT:
+		sortPending(floats);
+		break;
+	default:
+		sortPending(strings);
+		break;
+	}
+	sortedCount = size();
 }
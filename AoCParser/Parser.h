@@ -1,15 +1,24 @@
 #pragma once
 #include "Tokenizer.h"
+#include "Intern.h"
+#include "Profiler.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "InputCache.h"
+#include "StringRef.h"
 #include <string>
 #include <iostream>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
 #include <iomanip> // For manipulators : std::setprecision(2)
 #include "PrintHelper.h"
 
 bool ReadFile(const std::string& filePath, std::string& fileContents);
-void SyntaxError(Tokenizer& tokenizer, Token token, std::string expected);
-void RuntimeError(std::string expected);
+[[noreturn]] void SyntaxError(Tokenizer& tokenizer, Token token, std::string expected);
+[[noreturn]] void RuntimeError(std::string expected);
 
 enum class VariableType
 {
@@ -39,20 +48,71 @@ static std::string VariableTypeToString(VariableType type)
 struct StackVariable {
 	StackVariable() : StackVariable(0) { }
 	StackVariable(int intValue)
-		: type(VariableType::INTEGER), intValue(intValue), strValue(""), fltValue(0.0f) {}
+		: type(VariableType::INTEGER), intValue(intValue), strValue(""), shared(nullptr), sharedLength(0), interned(false), fltValue(0.0f) {}
 
 	StackVariable(std::string strValue)
-		: type(VariableType::STRING), intValue(0), strValue(strValue), fltValue(0.0f) {}
+		: type(VariableType::STRING), intValue(0), strValue(std::move(strValue)), shared(nullptr), sharedLength(0), interned(false), fltValue(0.0f) {
+		Stats::CountString(this->strValue.length());
+	}
+
+	explicit StackVariable(const std::string* interned)
+		: type(VariableType::STRING), intValue(0), strValue(""), shared(interned->data()), sharedLength(interned->length()), interned(true), fltValue(0.0f) {}
 
 	StackVariable(float fltValue)
-		: type(VariableType::FLOAT), intValue(0), strValue(""), fltValue(fltValue) {}
+		: type(VariableType::FLOAT), intValue(0), strValue(""), shared(nullptr), sharedLength(0), interned(false), fltValue(fltValue) {}
+
+	// A line of the Day input, shared like an interned string but compared by value since equal lines are different strings.
+	static StackVariable Line(StringRef line) {
+		StackVariable var;
+		var.type = VariableType::STRING;
+		var.shared = line.data();
+		var.sharedLength = line.length();
+		return var;
+	}
 
 	VariableType type;
 
 	int intValue;
 	std::string strValue;
+	// Set when the value is an interned string or a line in the text of the Day input, copying the variable then only copies the pointer.
+	// The string is copied into strValue the first time it is modified.
+	const char* shared;
+	size_t sharedLength;
+	bool interned; // Two interned strings are equal only if they are the same string.
 	float fltValue;
 
+	StringRef GetString() const {
+		return shared != nullptr ? StringRef(shared, sharedLength) : StringRef(strValue);
+	}
+
+	std::string& GetMutableString() {
+		if (shared != nullptr) {
+			strValue.assign(shared, sharedLength);
+			shared = nullptr;
+			interned = false;
+			Stats::CountString(strValue.length());
+		}
+		return strValue;
+	}
+
+	// A line only lives as long as the input it was read from, which a later load can free. Values stored in a variable
+	// or a list outlive the loop over the lines, so they keep their own copy.
+	void DetachLine() {
+		if (shared != nullptr && !interned) {
+			GetMutableString();
+		}
+	}
+
+	bool StringEquals(const StackVariable& other) const {
+		if (shared != nullptr && shared == other.shared && sharedLength == other.sharedLength) {
+			return true;
+		}
+		if (interned && other.interned) {
+			return false;
+		}
+		return GetString() == other.GetString();
+	}
+
 	int GetSortPrio() const {
 		switch (type)
 		{
@@ -60,7 +120,7 @@ struct StackVariable {
 			return intValue;
 			break;
 		case VariableType::STRING:
-			return static_cast<int>(strValue.length());
+			return static_cast<int>(GetString().length());
 			break;
 		case VariableType::FLOAT:
 			return static_cast<int>(fltValue);
@@ -73,7 +133,7 @@ struct StackVariable {
 	bool operator<(const StackVariable& other) const {
 		if (type == VariableType::STRING && other.type == VariableType::STRING)
 		{
-			return strValue < other.strValue;
+			return GetString() < other.GetString();
 		}
 
 		return GetSortPrio() < other.GetSortPrio();
@@ -82,55 +142,185 @@ struct StackVariable {
 
 struct List
 {
-	List(VariableType type) : type(type) {}
+	List(VariableType type) : type(type), countsValid(false) { Stats::Count(&StatCounters::listAllocations); }
+	virtual ~List() = default;
+	virtual List* clone() const { return new List(*this); }
 	VariableType type;
-	std::vector<StackVariable> list;
+	// Elements are stored unboxed in the vector matching the list type, so native kernels can loop directly over them.
+	// The other two vectors are always empty.
+	std::vector<int> ints;
+	std::vector<float> floats;
+	std::vector<StackVariable> strings;
+
+	size_t size() const {
+		switch (type)
+		{
+		case VariableType::INTEGER:
+			return ints.size();
+		case VariableType::FLOAT:
+			return floats.size();
+		default:
+			return strings.size();
+		}
+	}
+
+	StackVariable get_var(size_t index) const {
+		switch (type)
+		{
+		case VariableType::INTEGER:
+			return ints[index];
+		case VariableType::FLOAT:
+			return floats[index];
+		default:
+			return strings[index];
+		}
+	}
 
 	virtual void push_var(StackVariable var);
 	virtual StackVariable pop_var();
 	virtual void set_var(int index, StackVariable expressionVar);
+	// Replaces all elements with the elements of 'other', which must have the same type.
+	virtual void assign(const List& other);
+	virtual void clear();
+	// Sorts the elements in place, INTEGER lists are radix sorted.
+	virtual void sort();
+	// Brings elements appended through RuntimeGlobals::get_unsettled_list into place before the list is read.
+	virtual void settle() {}
+
+	// Number of elements equal to value. A hash index of the counts is built on first use and dropped when the list is modified.
+	int count_var(const StackVariable& value);
+
+	// True when the elements are known to be in ascending order, the searches below then use binary search.
+	virtual bool is_sorted() const { return false; }
+	// The searches expect value to have the list type.
+	int count_equal(const StackVariable& value) const;
+	int find_index(const StackVariable& value) const; // Index of the first element equal to value, -1 if there is none.
+	int lower_bound(const StackVariable& value) const; // Number of elements less than value.
+
+protected:
+	bool countsValid;
+	std::unordered_map<int, int> intCounts;
+	std::unordered_map<std::string, int> stringCounts;
 };
 
+// Appended elements are kept unsorted at the end of the storage and sorted in bulk when the list is settled,
+// so filling a sorted list costs one sort instead of one insertion per element.
 struct SortedList : List
 {
-	SortedList(VariableType type) : List(type) {}
+	SortedList(VariableType type) : List(type), sortedCount(0) {}
+	virtual List* clone() const override { return new SortedList(*this); }
 	virtual void push_var(StackVariable var) override;
 	virtual void set_var(int index, StackVariable expressionVar) override;
+	virtual void assign(const List& other) override;
+	virtual void clear() override;
+	virtual void sort() override;
+	virtual void settle() override;
+	virtual bool is_sorted() const override { return sortedCount == size(); }
+private:
+	size_t sortedCount; // Elements before this index are sorted, the rest are pending.
 };
 
 class RuntimeGlobals
 {
 public:
 	RuntimeGlobals() {
-		stack = {};
 		variables = {};
-		DayLines = {};
-		DayString = "";
+		DayInput = nullptr;
 		DayFileName = "";
+		InputFileName = "";
+		WorkingDirectory = "";
+		output = &std::cout;
+		loadedFiles = nullptr;
 		breakCounter = 0;
 	}
 
+	// Frame for a worker of a parallel loop. Variables and lists are copied so workers never share anything mutable,
+	// the Day input is shared since it is never modified after loading.
+	explicit RuntimeGlobals(const RuntimeGlobals& parent)
+		: variables(parent.variables), DayInput(parent.DayInput), DayFileName(parent.DayFileName),
+		InputFileName(parent.InputFileName), WorkingDirectory(parent.WorkingDirectory), output(parent.output), loadedFiles(nullptr), breakCounter(0)
+	{
+		lists.reserve(parent.lists.size());
+		for (List* list : parent.lists)
+		{
+			lists.push_back(list != nullptr ? list->clone() : nullptr);
+		}
+	}
+	RuntimeGlobals& operator=(const RuntimeGlobals&) = delete;
+
 	~RuntimeGlobals() {
-		for (auto& pair : lists)
+		for (List* list : lists)
 		{
-			delete pair.second;
+			delete list;
 		}
 	}	
 
-	std::vector<StackVariable> stack;
-	std::map<std::string, StackVariable> variables;
-	std::map<std::string, List*> lists;
+	// Variables are stored in slots indexed by the Symbol of their identifier.
+	struct VariableSlot {
+		bool defined = false;
+		StackVariable var;
+	};
+	std::vector<VariableSlot> variables;
+	// Lists are stored in slots assigned by the parser when the list is declared, see Parser::declaredLists.
+	std::vector<List*> lists;
 
-	std::vector<std::string> DayLines;
-	std::string DayString;
+	// Shared by every run that loads the same file, LINE points into its lines instead of copying the line for every statement.
+	std::shared_ptr<const LoadedInput> DayInput;
 	std::string DayFileName;
+	// Set by the batch runner, load statements read this file instead of the one named in the script.
+	std::string InputFileName;
+	// Set by the server to the directory of the client, relative paths of load statements are read from there.
+	std::string WorkingDirectory;
+	// Print statements write here, workers of a parallel loop buffer their output and it is written in line order.
+	std::ostream* output;
+	// Set by --watch, load statements add the path of every file they read so a changed input can be run again.
+	std::vector<std::string>* loadedFiles;
+
+	size_t DayLineCount() const { return DayInput != nullptr ? DayInput->LineCount() : 0; }
+
+	std::string ResolvePath(const std::string& path) const {
+		bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.length() > 1 && path[1] == ':'));
+		return WorkingDirectory.empty() || absolute ? path : WorkingDirectory + "/" + path;
+	}
+
+	StackVariable* find_var(Symbol symbol) {
+		Stats::Count(&StatCounters::variableReads);
+		if (static_cast<size_t>(symbol) < variables.size() && variables[symbol].defined) {
+			return &variables[symbol].var;
+		}
+		return nullptr;
+	}
+
+	StackVariable& set_var(Symbol symbol) {
+		Stats::Count(&StatCounters::variableWrites);
+		if (static_cast<size_t>(symbol) >= variables.size()) {
+			variables.resize(symbol + 1);
+			Stats::CountMax(&StatCounters::variableSlots, static_cast<long long>(variables.size()));
+		}
+		variables[symbol].defined = true;
+		return variables[symbol].var;
+	}
+
+	void erase_var(Symbol symbol) {
+		if (static_cast<size_t>(symbol) < variables.size()) {
+			variables[symbol].defined = false;
+			variables[symbol].var = StackVariable();
+		}
+	}
 
-	void push_var(int var) { push_var(StackVariable(var)); };
-	void push_var(std::string var) { push_var(StackVariable(var)); };
-	void push_var(float var) { push_var(StackVariable(var)); };
-	void push_var(StackVariable var);
-	StackVariable pop_var();
+	List* get_list(int listSlot, const std::string& id_name) {
+		List* list = get_unsettled_list(listSlot, id_name);
+		list->settle();
+		return list;
+	}
 
+	// Only for appending, a sorted list may still have its appended elements out of order.
+	List* get_unsettled_list(int listSlot, const std::string& id_name) {
+		if (static_cast<size_t>(listSlot) >= lists.size() || lists[listSlot] == nullptr) {
+			RuntimeError("Could not find list '" + id_name + "'");
+		}
+		return lists[listSlot];
+	}
 
 	void push_break() { ++breakCounter; };
 	bool pop_break() {
@@ -150,68 +340,104 @@ public:
 	virtual ~TreeNode() = default;
 
 	virtual void print() = 0;
-	virtual void eval(RuntimeGlobals* globals) = 0;
 };
 
-class Statement : public TreeNode
+// Expressions return their value directly, they never have side effects on RuntimeGlobals.
+class ExpressionNode : public TreeNode
+{
+public:
+	virtual ~ExpressionNode() override = default;
+	virtual StackVariable evaluate(RuntimeGlobals* globals) = 0;
+};
+
+// Statements only have side effects and never produce a value.
+class StatementNode : public TreeNode
+{
+public:
+	virtual ~StatementNode() override = default;
+	virtual void exec(RuntimeGlobals* globals) = 0;
+};
+
+class Statement : public StatementNode
 {
 public:
-	Statement(TreeNode* statement) : statement(statement) {}
+	Statement(StatementNode* statement, int line, int profileId, bool traced = false) : statement(statement), line(line), profileId(profileId), traced(traced) {}
 	virtual ~Statement() override = default;
-	TreeNode* statement;
+	StatementNode* statement;
+	int line;
+	int profileId; // -1 when neither --profile, --trace nor --perf-counters is used.
+	bool traced; // Shown on the timeline of --trace, nested statements other than loops and loads aren't.
 	virtual void print() override {
 		statement->print(); std::cout << ";\n";
 	}
 
-	virtual void eval(RuntimeGlobals* globals) override {
-		statement->eval(globals);
-		globals->pop_var();
+	// Every statement, including the ones nested in loops and ifs, is executed through here.
+	virtual void exec(RuntimeGlobals* globals) override {
+		if (Profiler::enabled || Stats::enabled || Trace::enabled) {
+			execInstrumented(globals);
+		}
+		else {
+			statement->exec(globals);
+		}
+	}
+
+private:
+	void execInstrumented(RuntimeGlobals* globals) {
+		StatsDepthScope depth;
+		TraceScope trace(traced ? profileId : -1);
+		if (Profiler::enabled) {
+			ProfileScope scope(profileId);
+			statement->exec(globals);
+		}
+		else {
+			statement->exec(globals);
+		}
 	}
 };
 
-class IS_OPERATOR : public TreeNode
+class IS_OPERATOR : public ExpressionNode
 {
 public:
-	IS_OPERATOR(TreeNode* left) : left(left) {}
+	IS_OPERATOR(ExpressionNode* left) : left(left) {}
 	virtual ~IS_OPERATOR() override = default;
-	TreeNode* left;
+	ExpressionNode* left;
 };
 
 class IS_DIGIT : public IS_OPERATOR
 {
 public:
-	IS_DIGIT(TreeNode* left) : IS_OPERATOR(left) {}
+	IS_DIGIT(ExpressionNode* left) : IS_OPERATOR(left) {}
 	virtual ~IS_DIGIT() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " IS DIGIT";
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		StackVariable var = globals->pop_var();
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("IS_DIGIT");
+		StackVariable var = left->evaluate(globals);
 
 		if (var.type == VariableType::STRING) {
-			bool isDigit = var.strValue.size() > 0;
-			for (char& c : var.strValue) {
+			StringRef value = var.GetString();
+			bool isDigit = value.size() > 0;
+			for (char c : value) {
 				if (!std::isdigit(c)) {
 					isDigit = false;
 					break;
 				}
 			}
-			globals->push_var(static_cast<int>(isDigit));
-		}
-		else {
-			// The other types are already known to be digits
-			globals->push_var(1);
+			return static_cast<int>(isDigit);
 		}
+
+		// The other types are already known to be digits
+		return 1;
 	}
 };
 
 class IS_ALPHA : public IS_OPERATOR
 {
 public:
-	IS_ALPHA(TreeNode* left) : IS_OPERATOR(left) {}
+	IS_ALPHA(ExpressionNode* left) : IS_OPERATOR(left) {}
 	virtual ~IS_ALPHA() override = default;
 
 	virtual void print() override {
@@ -219,53 +445,51 @@ public:
 		left->print(); std::cout << " IS ALPHA";
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		StackVariable var = globals->pop_var();
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("IS_ALPHA");
+		StackVariable var = left->evaluate(globals);
 
 		if (var.type == VariableType::STRING) {
-			bool isAlpha = var.strValue.size() > 0;
-			for (char& c : var.strValue) {
+			StringRef value = var.GetString();
+			bool isAlpha = value.size() > 0;
+			for (char c : value) {
 				if (!std::isalpha(c)) {
 					isAlpha = false;
 					break;
 				}
 			}
-			globals->push_var(static_cast<int>(isAlpha));
-		}
-		else {
-			// The other types are already know to not be alpha
-			globals->push_var(0);
+			return static_cast<int>(isAlpha);
 		}
+
+		// The other types are already know to not be alpha
+		return 0;
 	}
 };
 
-class OPERATOR : public TreeNode
+class OPERATOR : public ExpressionNode
 {
 public:
-	OPERATOR(TreeNode* left, TreeNode* right) : left(left), right(right) {}
+	OPERATOR(ExpressionNode* left, ExpressionNode* right) : left(left), right(right) {}
 	virtual ~OPERATOR() override = default;
-	TreeNode* left;
-	TreeNode* right;
+	ExpressionNode* left;
+	ExpressionNode* right;
 };
 
 
 class ADD : public OPERATOR
 {
 public:
-	ADD(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	ADD(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~ADD() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " + "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		StackVariable left_var = globals->pop_var();
-
-		right->eval(globals);
-		StackVariable right_var = globals->pop_var();
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("ADD");
+		StackVariable left_var = left->evaluate(globals);
+		StackVariable right_var = right->evaluate(globals);
 
 		if (left_var.type != right_var.type) {
 			RuntimeError("Type mismatch: " + VariableTypeToString(left_var.type) + " + " + VariableTypeToString(right_var.type));
@@ -274,112 +498,102 @@ public:
 		switch (left_var.type)
 		{
 		case VariableType::INTEGER:
-			globals->push_var(left_var.intValue + right_var.intValue);
+			left_var.intValue += right_var.intValue;
 			break;
 		case VariableType::STRING:
-			globals->push_var(left_var.strValue + right_var.strValue);
+			// left_var is a temporary copy, append into its buffer instead of allocating a third string.
+			left_var.GetMutableString() += right_var.GetString();
 			break;
 		case VariableType::FLOAT:
-			globals->push_var(left_var.fltValue + right_var.fltValue);
+			left_var.fltValue += right_var.fltValue;
 			break;
-		}		
+		}
+		return left_var;
 	}
 };
 
 class SUBTRACT : public OPERATOR
 {
 public:
-	SUBTRACT(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	SUBTRACT(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~SUBTRACT() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " - "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		int left = globals->pop_var().intValue;
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("SUBTRACT");
+		int left_value = left->evaluate(globals).intValue;
+		int right_value = right->evaluate(globals).intValue;
 
-		right->eval(globals);
-		int right = globals->pop_var().intValue;
-
-		int result = left - right;
-		globals->push_var(result);
+		return left_value - right_value;
 	}
 };
 
 class MULT : public OPERATOR
 {
 public:
-	MULT(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	MULT(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~MULT() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " * "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		int left = globals->pop_var().intValue;
-
-		right->eval(globals);
-		int right = globals->pop_var().intValue;
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("MULT");
+		int left_value = left->evaluate(globals).intValue;
+		int right_value = right->evaluate(globals).intValue;
 
-		int result = left * right;
-		globals->push_var(result);
+		return left_value * right_value;
 	}
 };
 
 class DIV : public OPERATOR
 {
 public:
-	DIV(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	DIV(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~DIV() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " / "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		int left = globals->pop_var().intValue;
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("DIV");
+		int left_value = left->evaluate(globals).intValue;
+		int right_value = right->evaluate(globals).intValue;
 
-		right->eval(globals);
-		int right = globals->pop_var().intValue;
-
-		int result = left / right;
-		globals->push_var(result);
+		return left_value / right_value;
 	}
 };
 
 class MODULO : public OPERATOR
 {
 public:
-	MODULO(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	MODULO(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~MODULO() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " MODULO "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		int left = globals->pop_var().intValue;
-
-		right->eval(globals);
-		int right = globals->pop_var().intValue;
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("MODULO");
+		int left_value = left->evaluate(globals).intValue;
+		int right_value = right->evaluate(globals).intValue;
 
-		int result = left % right;
-		globals->push_var(result);
+		return left_value % right_value;
 	}
 };
 
-class CAST : public TreeNode
+class CAST : public ExpressionNode
 {
 public:
-	CAST(TreeNode* left, VariableType type) : left(left), type(type) {}
+	CAST(ExpressionNode* left, VariableType type) : left(left), type(type) {}
 	virtual ~CAST() override = default;
-	TreeNode* left;
+	ExpressionNode* left;
 	VariableType type;
 
 	virtual void print() override {
@@ -388,195 +602,195 @@ public:
 		std::cout << VariableTypeToString(type);
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override;
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override;
 };
 
 class GREATER_THAN : public OPERATOR
 {
 public:
-	GREATER_THAN(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	GREATER_THAN(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~GREATER_THAN() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " > "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		StackVariable left_var = globals->pop_var();
-
-		right->eval(globals);
-		StackVariable right_var = globals->pop_var();
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("GREATER_THAN");
+		StackVariable left_var = left->evaluate(globals);
+		StackVariable right_var = right->evaluate(globals);
 
 		if (left_var.type != right_var.type) {
 			RuntimeError("Type mismatch: " + VariableTypeToString(left_var.type) + " > " + VariableTypeToString(right_var.type));
 		}
 
+		bool result = false;
 		switch (left_var.type)
 		{
 		case VariableType::INTEGER:
-			globals->push_var(static_cast<int>(left_var.intValue > right_var.intValue));
+			result = left_var.intValue > right_var.intValue;
 			break;
 		case VariableType::STRING:
-			globals->push_var(static_cast<int>(left_var.strValue > right_var.strValue));
+			result = left_var.GetString() > right_var.GetString();
 			break;
 		case VariableType::FLOAT:
-			globals->push_var(static_cast<int>(left_var.fltValue > right_var.fltValue));
+			result = left_var.fltValue > right_var.fltValue;
 			break;
 		}
+		return static_cast<int>(result);
 	}
 };
 
 class GREATER_EQUALS : public OPERATOR
 {
 public:
-	GREATER_EQUALS(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	GREATER_EQUALS(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~GREATER_EQUALS() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " >= "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		StackVariable left_var = globals->pop_var();
-
-		right->eval(globals);
-		StackVariable right_var = globals->pop_var();
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("GREATER_EQUALS");
+		StackVariable left_var = left->evaluate(globals);
+		StackVariable right_var = right->evaluate(globals);
 
 		if (left_var.type != right_var.type) {
 			RuntimeError("Type mismatch: " + VariableTypeToString(left_var.type) + " >= " + VariableTypeToString(right_var.type));
 		}
 
+		bool result = false;
 		switch (left_var.type)
 		{
 		case VariableType::INTEGER:
-			globals->push_var(static_cast<int>(left_var.intValue >= right_var.intValue));
+			result = left_var.intValue >= right_var.intValue;
 			break;
 		case VariableType::STRING:
-			globals->push_var(static_cast<int>(left_var.strValue >= right_var.strValue));
+			result = left_var.GetString() >= right_var.GetString();
 			break;
 		case VariableType::FLOAT:
-			globals->push_var(static_cast<int>(left_var.fltValue >= right_var.fltValue));
+			result = left_var.fltValue >= right_var.fltValue;
 			break;
 		}
+		return static_cast<int>(result);
 	}
 };
 
 class LESS_THAN : public OPERATOR
 {
 public:
-	LESS_THAN(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	LESS_THAN(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~LESS_THAN() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " < "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		StackVariable left_var = globals->pop_var();
-
-		right->eval(globals);
-		StackVariable right_var = globals->pop_var();
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("LESS_THAN");
+		StackVariable left_var = left->evaluate(globals);
+		StackVariable right_var = right->evaluate(globals);
 
 		if (left_var.type != right_var.type) {
 			RuntimeError("Type mismatch: " + VariableTypeToString(left_var.type) + " < " + VariableTypeToString(right_var.type));
 		}
 
+		bool result = false;
 		switch (left_var.type)
 		{
 		case VariableType::INTEGER:
-			globals->push_var(static_cast<int>(left_var.intValue < right_var.intValue));
+			result = left_var.intValue < right_var.intValue;
 			break;
 		case VariableType::STRING:
-			globals->push_var(static_cast<int>(left_var.strValue < right_var.strValue));
+			result = left_var.GetString() < right_var.GetString();
 			break;
 		case VariableType::FLOAT:
-			globals->push_var(static_cast<int>(left_var.fltValue < right_var.fltValue));
+			result = left_var.fltValue < right_var.fltValue;
 			break;
 		}
+		return static_cast<int>(result);
 	}
 };
 
 class LESS_EQUALS : public OPERATOR
 {
 public:
-	LESS_EQUALS(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	LESS_EQUALS(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~LESS_EQUALS() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " <= "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		StackVariable left_var = globals->pop_var();
-
-		right->eval(globals);
-		StackVariable right_var = globals->pop_var();
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("LESS_EQUALS");
+		StackVariable left_var = left->evaluate(globals);
+		StackVariable right_var = right->evaluate(globals);
 
 		if (left_var.type != right_var.type) {
 			RuntimeError("Type mismatch: " + VariableTypeToString(left_var.type) + " <= " + VariableTypeToString(right_var.type));
 		}
 
+		bool result = false;
 		switch (left_var.type)
 		{
 		case VariableType::INTEGER:
-			globals->push_var(static_cast<int>(left_var.intValue <= right_var.intValue));
+			result = left_var.intValue <= right_var.intValue;
 			break;
 		case VariableType::STRING:
-			globals->push_var(static_cast<int>(left_var.strValue <= right_var.strValue));
+			result = left_var.GetString() <= right_var.GetString();
 			break;
 		case VariableType::FLOAT:
-			globals->push_var(static_cast<int>(left_var.fltValue <= right_var.fltValue));
+			result = left_var.fltValue <= right_var.fltValue;
 			break;
 		}
+		return static_cast<int>(result);
 	}
 };
 
 class IS_EQUAL : public OPERATOR
 {
 public:
-	IS_EQUAL(TreeNode* left, TreeNode* right) : OPERATOR(left, right) {}
+	IS_EQUAL(ExpressionNode* left, ExpressionNode* right) : OPERATOR(left, right) {}
 	virtual ~IS_EQUAL() override = default;
 	virtual void print() override {
 		std::cout << "(";
 		left->print(); std::cout << " == "; right->print();
 		std::cout << ")";
 	}
-	virtual void eval(RuntimeGlobals* globals) override {
-		left->eval(globals);
-		StackVariable left_var = globals->pop_var();
-
-		right->eval(globals);
-		StackVariable right_var = globals->pop_var();
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("IS_EQUAL");
+		StackVariable left_var = left->evaluate(globals);
+		StackVariable right_var = right->evaluate(globals);
 
 		if (left_var.type != right_var.type) {
 			RuntimeError("Type mismatch: " + VariableTypeToString(left_var.type) + " == " + VariableTypeToString(right_var.type));
 		}
 
+		bool result = false;
 		switch (left_var.type)
 		{
 		case VariableType::INTEGER:
-			globals->push_var(static_cast<int>(left_var.intValue == right_var.intValue));
+			result = left_var.intValue == right_var.intValue;
 			break;
 		case VariableType::STRING:
-			globals->push_var(static_cast<int>(left_var.strValue == right_var.strValue));
+			result = left_var.StringEquals(right_var);
 			break;
 		case VariableType::FLOAT:
-			globals->push_var(static_cast<int>(left_var.fltValue == right_var.fltValue));
+			result = left_var.fltValue == right_var.fltValue;
 			break;
 		}
+		return static_cast<int>(result);
 	}
 };
 
-class NEGATE : public TreeNode
+class NEGATE : public ExpressionNode
 {
 public:
-	NEGATE(TreeNode* arg) :arg(arg) {}
+	NEGATE(ExpressionNode* arg) :arg(arg) {}
 	virtual ~NEGATE() override = default;
-	TreeNode* arg;
+	ExpressionNode* arg;
 
 	virtual void print() override {
 		std::cout << "(";
@@ -584,49 +798,70 @@ public:
 		std::cout << ")";
 	}
 
-	virtual void eval(RuntimeGlobals* globals) override { 
-		arg->eval(globals);
-		int arg_value = globals->pop_var().intValue;
-		globals->push_var(-arg_value);
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override { 
+		Stats::CountNode("NEGATE");
+		int arg_value = arg->evaluate(globals).intValue;
+		return -arg_value;
+	}
+};
+
+class ABS : public ExpressionNode
+{
+public:
+	ABS(ExpressionNode* arg) :arg(arg) {}
+	virtual ~ABS() override = default;
+	ExpressionNode* arg;
+
+	virtual void print() override {
+		std::cout << "(ABS "; arg->print(); std::cout << ")";
+	}
+
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("ABS");
+		StackVariable arg_var = arg->evaluate(globals);
+		if (arg_var.type == VariableType::INTEGER) {
+			return arg_var.intValue < 0 ? -arg_var.intValue : arg_var.intValue;
+		}
+		else if (arg_var.type == VariableType::FLOAT) {
+			return arg_var.fltValue < 0 ? -arg_var.fltValue : arg_var.fltValue;
+		}
+		RuntimeError("abs is only supported for INTEGER and FLOAT");
 	}
 };
 
-class ID : public TreeNode
+class ID : public ExpressionNode
 {
 public:
-	ID(std::string str) : str(str) {}
+	ID(std::string str) : str(str), symbol(InternTable::Intern(str)) {}
 	virtual ~ID() override = default;
 	std::string str;
+	Symbol symbol;
 
 public:
 	virtual void print() override { std::cout << str; }
-	virtual void eval(RuntimeGlobals* globals) override 
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override 
 	{
-		auto found = globals->variables.find(str);
-		if (found != globals->variables.end()) {
-			VariableType type = globals->variables[str].type;
-			if (type == VariableType::INTEGER) {
-				globals->push_var(globals->variables[str].intValue);
-			}
-			else if (type == VariableType::STRING) {
-				globals->push_var(globals->variables[str].strValue);
-			}
-			else if (type == VariableType::FLOAT) {
-				globals->push_var(globals->variables[str].fltValue);
-			}
-		}
-		else {
+		Stats::CountNode("ID");
+		return get(globals);
+	}
+
+	// Access the variable in place, for nodes that only read from it or modify it.
+	StackVariable& get(RuntimeGlobals* globals)
+	{
+		StackVariable* var = globals->find_var(symbol);
+		if (var == nullptr) {
 			RuntimeError("Identifier " + str + " does not exist!");
 		}
+		return *var;
 	}
 };
 
-class ARRAY_SIZE : public TreeNode
+class ARRAY_SIZE : public ExpressionNode
 {
 public:
-	ARRAY_SIZE(TreeNode* id) :id(id) {}
+	ARRAY_SIZE(ID* id) :id(id) {}
 	virtual ~ARRAY_SIZE() override = default;
-	TreeNode* id;
+	ID* id;
 
 	virtual void print() override {
 		std::cout << "(";
@@ -634,33 +869,45 @@ public:
 		std::cout << " SIZE";
 		std::cout << ")";
 	}
+};
 
-	virtual void eval(RuntimeGlobals* globals) override {
-		std::string id_name = reinterpret_cast<ID*>(id)->str;
-		if (globals->lists.find(id_name) != globals->lists.end())
-		{
-			globals->push_var(static_cast<int>(globals->lists[id_name]->list.size()));
-		}
-		else {
-			id->eval(globals);
-			StackVariable var = globals->pop_var();
-			if (var.type == VariableType::STRING) {
-				globals->push_var(static_cast<int>(var.strValue.length()));
-			}
-			else {
-				RuntimeError("Variable of type " + VariableTypeToString(var.type) + " can't be indexed.");
-			}
+class LIST_SIZE : public ARRAY_SIZE
+{
+public:
+	LIST_SIZE(ID* id, int listSlot) : ARRAY_SIZE(id), listSlot(listSlot) {}
+	virtual ~LIST_SIZE() override = default;
+	int listSlot;
+
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("LIST_SIZE");
+		List* list = globals->get_list(listSlot, id->str);
+		return static_cast<int>(list->size());
+	}
+};
+
+class STRING_SIZE : public ARRAY_SIZE
+{
+public:
+	STRING_SIZE(ID* id) : ARRAY_SIZE(id) {}
+	virtual ~STRING_SIZE() override = default;
+
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("STRING_SIZE");
+		const StackVariable& var = id->get(globals);
+		if (var.type != VariableType::STRING) {
+			RuntimeError("Variable of type " + VariableTypeToString(var.type) + " can't be indexed.");
 		}
+		return static_cast<int>(var.GetString().length());
 	}
 };
 
-class ARRAY_INDEXING : public TreeNode
+class ARRAY_INDEXING : public ExpressionNode
 {
 public:
-	ARRAY_INDEXING(TreeNode* id, TreeNode* expression) :id(id), expression(expression) {}
+	ARRAY_INDEXING(ID* id, ExpressionNode* expression) :id(id), expression(expression) {}
 	virtual ~ARRAY_INDEXING() override = default;
-	TreeNode* id;
-	TreeNode* expression;
+	ID* id;
+	ExpressionNode* expression;
 
 	virtual void print() override {
 		std::cout << "(";
@@ -669,67 +916,86 @@ public:
 		std::cout << ")";
 	}
 
-	virtual void eval(RuntimeGlobals* globals) override {
-		std::string id_name = reinterpret_cast<ID*>(id)->str;
-		expression->eval(globals);
-		StackVariable varIndex = globals->pop_var();
+protected:
+	int EvaluateIndex(RuntimeGlobals* globals) {
+		StackVariable varIndex = expression->evaluate(globals);
 		if (varIndex.type != VariableType::INTEGER) {
-			RuntimeError("Can't index array " + id_name + " with index of type " + VariableTypeToString(varIndex.type) + ". Only INTEGER indices are allowed.");
+			RuntimeError("Can't index array " + id->str + " with index of type " + VariableTypeToString(varIndex.type) + ". Only INTEGER indices are allowed.");
 		}
 
 		int index = varIndex.intValue;
 		if (index < 0) {
 			RuntimeError("Array index must be possitive: " + index);
 		}
+		return index;
+	}
+};
 
-		if (globals->lists.find(id_name) != globals->lists.end())
-		{
-			List* list = globals->lists[id_name];
-			if (index >= list->list.size()) {
-				RuntimeError("Array index out of range: " + std::to_string(index)
-					+ ". Size = " + std::to_string(list->list.size()));
-			}
+// Whether 'id[index]' indexes a list or a string is decided by the parser from the list declarations.
+class LIST_INDEX : public ARRAY_INDEXING
+{
+public:
+	LIST_INDEX(ID* id, int listSlot, ExpressionNode* expression) : ARRAY_INDEXING(id, expression), listSlot(listSlot) {}
+	virtual ~LIST_INDEX() override = default;
+	int listSlot;
+
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("LIST_INDEX");
+		int index = EvaluateIndex(globals);
+
+		List* list = globals->get_list(listSlot, id->str);
+		if (static_cast<size_t>(index) >= list->size()) {
+			RuntimeError("Array index out of range: " + std::to_string(index)
+				+ ". Size = " + std::to_string(list->size()));
+		}
 
-			// VariableType is handled by push_var
-			globals->push_var(list->list[index]);
+		return list->get_var(index);
+	}
+};
+
+class STRING_INDEX : public ARRAY_INDEXING
+{
+public:
+	STRING_INDEX(ID* id, ExpressionNode* expression) : ARRAY_INDEXING(id, expression) {}
+	virtual ~STRING_INDEX() override = default;
+
+	virtual StackVariable evaluate(RuntimeGlobals* globals) override {
+		Stats::CountNode("STRING_INDEX");
+		int index = EvaluateIndex(globals);
+
+		const StackVariable& var = id->get(globals);
+		if (var.type != VariableType::STRING) {
+			RuntimeError("Variable of type " + VariableTypeToString(var.type) + " can't be indexed.");
 		}
-		else {
-			id->eval(globals);
-			StackVariable var = globals->pop_var();
-			if (var.type == VariableType::STRING) {
-				if (index >= var.strValue.length()) {
-					RuntimeError("Array index out of range: " + std::to_string(index)
-						+ ". Size = " + std::to_string(var.strValue.length()));
-				}
 
-				// Push it as a single string character instead of casting to an int.
-				globals->push_var(std::string(1, var.strValue[index]));
-			}
-			else {
-				RuntimeError("Variable of type " + VariableTypeToString(var.type) + " can't be indexed.");
-			}
+		StringRef value = var.GetString();
+		if (static_cast<size_t>(index) >= value.length()) {
+			RuntimeError("Array index out of range: " + std::to_string(index)
+				+ ". Size = " + std::to_string(value.length()));
 		}
+
+		// Return it as a single string character instead of casting to an int.
+		return StackVariable(InternTable::SingleChar(value[index]));
 	}
 };
 
-class EQUALS_INDEXED : public TreeNode
+class EQUALS_INDEXED : public StatementNode
 {
 public:
-	EQUALS_INDEXED(TreeNode* id, TreeNode* index, TreeNode* expression) : id(id), index(index), expression(expression) {}
+	EQUALS_INDEXED(ID* id, int listSlot, ExpressionNode* index, ExpressionNode* expression) : id(id), listSlot(listSlot), index(index), expression(expression) {}
 	virtual ~EQUALS_INDEXED() override = default;
-	TreeNode* id;
-	TreeNode* index;
-	TreeNode* expression;
+	ID* id;
+	int listSlot;
+	ExpressionNode* index;
+	ExpressionNode* expression;
 public:
 	virtual void print() override { id->print(); std::cout << " = "; expression->print(); }
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
-		std::string id_name = reinterpret_cast<ID*>(id)->str;
-
-		index->eval(globals);
-		StackVariable varIndex = globals->pop_var();
+		Stats::CountNode("EQUALS_INDEXED");
+		StackVariable varIndex = index->evaluate(globals);
 		if (varIndex.type != VariableType::INTEGER) {
-			RuntimeError("Can't index array " + id_name + " with index of type " + VariableTypeToString(varIndex.type) + ". Only INTEGER indices are allowed.");
+			RuntimeError("Can't index array " + id->str + " with index of type " + VariableTypeToString(varIndex.type) + ". Only INTEGER indices are allowed.");
 		}
 
 		int index = varIndex.intValue;
@@ -737,205 +1003,214 @@ public:
 			RuntimeError("Array index must be possitive: " + index);
 		}
 
-		expression->eval(globals);
-		StackVariable expressionVar = globals->pop_var();
-
-		if (globals->lists.find(id_name) != globals->lists.end())
-		{
-			List* list = globals->lists[id_name];
-			if (index >= list->list.size()) {
-				RuntimeError("Array index out of range: " + std::to_string(index)
-					+ ". Size = " + std::to_string(list->list.size()));
-			}
+		StackVariable expressionVar = expression->evaluate(globals);
 
-			if (expressionVar.type != list->type)
-			{
-				RuntimeError("Can't add value of type {" + VariableTypeToString(expressionVar.type) + "} to list "
-					+ id_name + "<" + VariableTypeToString(list->type) + ">");
-			}
+		List* list = globals->get_list(listSlot, id->str);
+		if (static_cast<size_t>(index) >= list->size()) {
+			RuntimeError("Array index out of range: " + std::to_string(index)
+				+ ". Size = " + std::to_string(list->size()));
+		}
 
-			list->set_var(index, expressionVar);
+		if (expressionVar.type != list->type)
+		{
+			RuntimeError("Can't add value of type {" + VariableTypeToString(expressionVar.type) + "} to list "
+				+ id->str + "<" + VariableTypeToString(list->type) + ">");
 		}
-		else {
-			id->eval(globals);
-			StackVariable idVar = globals->pop_var();
-			if (idVar.type == VariableType::STRING) {
-				if (index >= idVar.strValue.length()) {
-					RuntimeError("Array index out of range: " + std::to_string(index)
-						+ ". Size = " + std::to_string(idVar.strValue.length()));
-				}
 
-				idVar.strValue[index] = expressionVar.strValue[0];
-				globals->variables[id_name] = idVar;
-			}
-			else {
-				RuntimeError("Variable of type " + VariableTypeToString(idVar.type) + " can't be indexed.");
-			}
-		}		
+		list->set_var(index, expressionVar);
 	}
 };
 
-static std::string ColorizeString(std::string str)
+// Levels of the print statements, prints above PRINT_STATEMENT::threshold are removed by the Optimizer before they run.
+enum class PrintLevel
 {
-	auto replaceAll = [](std::string& str, const std::string& from, const std::string& to) {
-		size_t start_pos = 0;
-		while ((start_pos = str.find(from, start_pos)) != std::string::npos) {
-			str.replace(start_pos, from.length(), to);
-			start_pos += to.length(); // Move past the replacement to avoid infinite loop
-		}
-	};
+	QUIET,	// Only used as threshold, removes all prints. Set with --quiet.
+	PRINT,	// 'print' | 'simon says'
+	DEBUG,	// 'debug'
+	TRACE,	// 'trace'
+};
 
-	auto replaceColor = [replaceAll](std::string& str, std::string color, CONSOLE_COLOR consoleColor) {
-		if (str.find(color) != std::string::npos) {
-			replaceAll(str, color, ConsoleColorToString(consoleColor) + color);
-		}
-	};
-	replaceColor(str, "FAILED", CONSOLE_COLOR::RED);
-	replaceColor(str, "SUCCESS", CONSOLE_COLOR::GREEN);
-	replaceColor(str, "RED", CONSOLE_COLOR::RED);
-	replaceColor(str, "YELLOW", CONSOLE_COLOR::YELLOW);
-	replaceColor(str, "GREEN", CONSOLE_COLOR::GREEN);
-	replaceColor(str, "BLUE", CONSOLE_COLOR::BLUE);
-	replaceColor(str, "MAGENTA", CONSOLE_COLOR::MAGENTA);
-	replaceColor(str, "CYAN", CONSOLE_COLOR::CYAN);
-	replaceColor(str, "WHITE", CONSOLE_COLOR::WHITE);
-	return str;
-}
+class PRINT_STATEMENT : public StatementNode
+{
+public:
+	PRINT_STATEMENT(PrintLevel level) : level(level) {}
+	virtual ~PRINT_STATEMENT() override = default;
+	PrintLevel level;
 
-class PRINT_ID : public TreeNode
+	static PrintLevel threshold; // Set with --log-level, PRINT by default.
+	bool enabled() const { return level <= threshold; }
+};
+
+class PRINT_ID : public PRINT_STATEMENT
 {
 public:
-	PRINT_ID(TreeNode* id) : id(id) {}
+	PRINT_ID(ID* id, PrintLevel level) : PRINT_STATEMENT(level), id(id) {}
 	virtual ~PRINT_ID() override = default;
-	TreeNode* id;
+	ID* id;
 public:
 	virtual void print() override { std::cout << "print: "; id->print(); }
-	virtual void eval(RuntimeGlobals* globals) override {
+	virtual void exec(RuntimeGlobals* globals) override {
+		Stats::CountNode("PRINT_ID");
 		
-		std::string id_name = reinterpret_cast<ID*>(id)->str;
-		std::cout << "Simon Says: " << id_name << "\t= ";
-
-		if (globals->lists.find(id_name) != globals->lists.end())
-		{
-			std::cout << "[ ";
-			List* list = globals->lists[id_name];
-			bool first = true;
-			for (StackVariable& var : list->list)
-			{
-				if (!first) {
-					std::cout << ", ";
-				}
-				else {
-					first = false;
-				}
+		std::ostream& out = *globals->output;
+		out << "Simon Says: " << id->str << "\t= ";
 
-				switch (list->type)
-				{
-				case VariableType::INTEGER:
-					std::cout << var.intValue;
-					break;
-				case VariableType::STRING:
-					std::cout << var.strValue;
-					break;
-				case VariableType::FLOAT:
-					std::cout << var.fltValue;
-					break;
-				default:
-					break;
-				}
-			}
-			std::cout << " ]";
+		const StackVariable& var = id->get(globals);
+		if (var.type == VariableType::INTEGER) {
+			out << var.intValue;
 		}
-		else {
-			id->eval(globals);
-			StackVariable var = globals->pop_var();
-			if (var.type == VariableType::INTEGER) {
-				std::cout << var.intValue;
-			}
-			else if (var.type == VariableType::STRING) {
-				std::cout << "\'" << ColorizeString(var.strValue);
-				ResetConsoleColor();
-				std::cout << "\'";
+		else if (var.type == VariableType::STRING) {
+			out << "\'";
+			WriteColorized(out, var.GetString());
+			out << ConsoleColorToString(CONSOLE_COLOR::RESET);
+			out << "\'";
+		}
+		else if (var.type == VariableType::FLOAT) {
+			out << std::fixed << std::setprecision(2) << var.fltValue;
+		}
+		out << "\n";
+	}
+};
+
+class PRINT_LIST : public PRINT_STATEMENT
+{
+public:
+	PRINT_LIST(ID* id, int listSlot, PrintLevel level) : PRINT_STATEMENT(level), id(id), listSlot(listSlot) {}
+	virtual ~PRINT_LIST() override = default;
+	ID* id;
+	int listSlot;
+public:
+	virtual void print() override { std::cout << "print: "; id->print(); }
+	virtual void exec(RuntimeGlobals* globals) override {
+		Stats::CountNode("PRINT_LIST");
+
+		std::ostream& out = *globals->output;
+		out << "Simon Says: " << id->str << "\t= ";
+
+		out << "[ ";
+		List* list = globals->get_list(listSlot, id->str);
+		for (size_t i = 0; i < list->size(); i++)
+		{
+			if (i > 0) {
+				out << ", ";
 			}
-			else if (var.type == VariableType::FLOAT) {
-				std::cout << std::fixed << std::setprecision(2) << var.fltValue;
+
+			switch (list->type)
+			{
+			case VariableType::INTEGER:
+				out << list->ints[i];
+				break;
+			case VariableType::STRING:
+				out << list->strings[i].GetString();
+				break;
+			case VariableType::FLOAT:
+				out << list->floats[i];
+				break;
+			default:
+				break;
 			}
 		}
-		std::cout << "\n";
+		out << " ]";
+		out << "\n";
 	}
 };
 
-class PRINT_STR : public TreeNode
+class PRINT_STR : public PRINT_STATEMENT
 {
 public:
-	PRINT_STR(TreeNode* id) : id(id) {}
+	PRINT_STR(ExpressionNode* str, PrintLevel level) : PRINT_STATEMENT(level), str(str) {}
 	virtual ~PRINT_STR() override = default;
-	TreeNode* id;
+	ExpressionNode* str;
 public:
-	virtual void print() override { std::cout << "print: "; id->print(); }
-	virtual void eval(RuntimeGlobals* globals) override {
-		id->eval(globals);
-		std::string str = globals->pop_var().strValue;
-		std::cout << "Simon Says: \'" << ColorizeString(str);
-		ResetConsoleColor();
-		std::cout << "\'\n";
+	virtual void print() override { std::cout << "print: "; str->print(); }
+	virtual void exec(RuntimeGlobals* globals) override {
+		Stats::CountNode("PRINT_STR");
+		std::string str_value = str->evaluate(globals).GetString().str();
+		std::ostream& out = *globals->output;
+		out << "Simon Says: \'";
+		WriteColorized(out, str_value);
+		out << ConsoleColorToString(CONSOLE_COLOR::RESET);
+		out << "\'\n";
 	}
 
 private:
 	
 };
 
-class PRINT_DAY : public TreeNode
+class PRINT_DAY : public PRINT_STATEMENT
 {
 public:
-	PRINT_DAY() {}
+	PRINT_DAY(PrintLevel level) : PRINT_STATEMENT(level) {}
 	virtual ~PRINT_DAY() override = default;
 public:
 	virtual void print() override { std::cout << "print: DAY"; }
-	virtual void eval(RuntimeGlobals* globals) override {
-		std::cout << "Simon Says Todays input is {\n";
-		if (globals->DayString.length() == 0) { RuntimeError("Day input not loaded before access!"); }
-		std::cout << globals->DayString << "\n}" << std::endl;
+	virtual void exec(RuntimeGlobals* globals) override {
+		Stats::CountNode("PRINT_DAY");
+		std::ostream& out = *globals->output;
+		out << "Simon Says Todays input is {\n";
+		if (!globals->DayInput || globals->DayInput->text->length() == 0) { RuntimeError("Day input not loaded before access!"); }
+		out << *globals->DayInput->text << "\n}\n";
 	}
 };
 
-class LOAD : public TreeNode
+class LOAD : public StatementNode
 {
 public:
-	LOAD(TreeNode* str) : str(str) {}
+	LOAD(ExpressionNode* str) : str(str) {}
 	virtual ~LOAD() override = default;
-	TreeNode* str;
+	ExpressionNode* str;
 public:
 	virtual void print() override { std::cout << "load: "; str->print(); }
-	virtual void eval(RuntimeGlobals* globals) override;
+	virtual void exec(RuntimeGlobals* globals) override;
 };
 
-class EQUALS : public TreeNode
+class EQUALS : public StatementNode
 {
 public:
-	EQUALS(TreeNode* id, TreeNode* expression) : id(id), expression(expression) {}
+	EQUALS(ID* id, ExpressionNode* expression) : id(id), expression(expression) {}
 	virtual ~EQUALS() override = default;
-	TreeNode* id;
-	TreeNode* expression;
+	ID* id;
+	ExpressionNode* expression;
 public:
 	virtual void print() override { id->print(); std::cout << " = "; expression->print(); }
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
-		std::string id_name = reinterpret_cast<ID*>(id)->str;
-		expression->eval(globals);
-		StackVariable var = globals->pop_var();
-		globals->variables[id_name] = var;
-		globals->push_var(var);
+		Stats::CountNode("EQUALS");
+		// The slot is only defined once the expression has run, 'x = x * 2' on an undefined x still fails.
+		StackVariable value = expression->evaluate(globals);
+		value.DetachLine();
+		globals->set_var(id->symbol) = std::move(value);
+	}
+};
+
+// In place 'id = id + a + b' or 'id += a'. Mutates the variable's own buffer instead of copying it
+// onto the stack and back into the map, which made building strings char by char O(n^2).
+class APPEND : public StatementNode
+{
+public:
+	APPEND(ID* id, std::vector<ExpressionNode*> expressions) : id(id), expressions(expressions) {}
+	virtual ~APPEND() override = default;
+	ID* id;
+	std::vector<ExpressionNode*> expressions;
+public:
+	virtual void print() override {
+		id->print(); std::cout << " += ";
+		for (size_t i = 0; i < expressions.size(); i++) {
+			if (i > 0) { std::cout << " + "; }
+			expressions[i]->print();
+		}
 	}
+	virtual void exec(RuntimeGlobals* globals) override;
 };
 
-class LIST_CREATE : public TreeNode
+class LIST_CREATE : public StatementNode
 {
 public:
-	LIST_CREATE(TreeNode* id, bool sorted, VariableType type)
-		: id(id), sorted(sorted), type(type) {}
+	LIST_CREATE(ID* id, int listSlot, bool sorted, VariableType type)
+		: id(id), listSlot(listSlot), sorted(sorted), type(type) {}
 	virtual ~LIST_CREATE() override = default;
-	TreeNode* id;
+	ID* id;
+	int listSlot;
 	bool sorted;
 	VariableType type;
 public:
@@ -944,65 +1219,110 @@ public:
 		id->print();
 		std::cout << " )";
 	}
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
-		std::string id_name = reinterpret_cast<ID*>(id)->str;
-		if (sorted)
+		Stats::CountNode("LIST_CREATE");
+		if (static_cast<size_t>(listSlot) >= globals->lists.size())
+		{
+			globals->lists.resize(listSlot + 1, nullptr);
+		}
+
+		// Declarations inside loops re-create the list every iteration. Each slot belongs to exactly one declaration
+		// so the type always matches, clear the list instead and keep the memory it grew to last time.
+		List*& list = globals->lists[listSlot];
+		if (list != nullptr)
+		{
+			list->clear();
+		}
+		else if (sorted)
 		{
-			globals->lists[id_name] = new SortedList(type);
+			list = new SortedList(type);
 		}
 		else
 		{
-			globals->lists[id_name] = new List(type);
+			list = new List(type);
 		}
 	}
 };
 
-class LIST_ADD : public TreeNode
+class LIST_ADD : public StatementNode
 {
 public:
-	LIST_ADD(TreeNode* id, TreeNode* expression)
-		: id(id), expression(expression) {}
+	LIST_ADD(ID* id, int listSlot, ExpressionNode* expression)
+		: id(id), listSlot(listSlot), expression(expression) {}
 	virtual ~LIST_ADD() override = default;
-	TreeNode* id;
-	TreeNode* expression;
+	ID* id;
+	int listSlot;
+	ExpressionNode* expression;
 public:
 	virtual void print() override {
 		id->print();
 		std::cout << " << ";
 		expression->print();
 	}
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
-		std::string id_name = reinterpret_cast<ID*>(id)->str;
-		if (globals->lists.find(id_name) == globals->lists.end())
-		{
-			RuntimeError("Could not find list '" + id_name + "'");
-		}
-
-		List* list = globals->lists[id_name];
+		Stats::CountNode("LIST_ADD");
+		List* list = globals->get_unsettled_list(listSlot, id->str);
 
-		expression->eval(globals);
-		StackVariable var = globals->pop_var();
+		StackVariable var = expression->evaluate(globals);
 
 		if (var.type != list->type) 
 		{
 			RuntimeError("Can't add value of type {" + VariableTypeToString(var.type) + "} to list " 
-				+ id_name + "<" + VariableTypeToString(list->type) + ">");
+				+ id->str + "<" + VariableTypeToString(list->type) + ">");
 		}
 
-		list->push_var(var);
+		list->push_var(std::move(var));
+	}
+};
+
+// 'load columns "file" into INTEGER list a, b', the n:th integer of every row is added to the n:th list.
+class LOAD_COLUMNS : public StatementNode
+{
+public:
+	LOAD_COLUMNS(ExpressionNode* str, std::vector<LIST_CREATE*> columns) : str(str), columns(columns) {}
+	virtual ~LOAD_COLUMNS() override = default;
+	ExpressionNode* str;
+	std::vector<LIST_CREATE*> columns;
+public:
+	virtual void print() override {
+		std::cout << "load columns: "; str->print(); std::cout << " into";
+		for (LIST_CREATE* column : columns)
+		{
+			std::cout << " "; column->id->print();
+		}
 	}
+	virtual void exec(RuntimeGlobals* globals) override;
 };
 
-class IF : public TreeNode
+class LIST_SORT : public StatementNode
 {
 public:
-	IF(TreeNode* condition, std::vector<TreeNode*> statements, std::vector<TreeNode*> else_statements) : condition(condition), statements(statements), else_statements(else_statements) {}
+	LIST_SORT(ID* id, int listSlot) : id(id), listSlot(listSlot) {}
+	virtual ~LIST_SORT() override = default;
+	ID* id;
+	int listSlot;
+public:
+	virtual void print() override {
+		std::cout << "SORT ";
+		id->print();
+	}
+	virtual void exec(RuntimeGlobals* globals) override
+	{
+		Stats::CountNode("LIST_SORT");
+		globals->get_list(listSlot, id->str)->sort();
+	}
+};
+
+class IF : public StatementNode
+{
+public:
+	IF(ExpressionNode* condition, std::vector<StatementNode*> statements, std::vector<StatementNode*> else_statements) : condition(condition), statements(statements), else_statements(else_statements) {}
 	virtual ~IF() override = default;
-	TreeNode* condition;
-	std::vector<TreeNode*> statements;
-	std::vector<TreeNode*> else_statements;
+	ExpressionNode* condition;
+	std::vector<StatementNode*> statements;
+	std::vector<StatementNode*> else_statements;
 public:
 	virtual void print() override {
 		std::cout << "IF "; condition->print(); std::cout << " : \n";
@@ -1018,34 +1338,34 @@ public:
 		std::cout << "END";
 
 	}
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
-		condition->eval(globals);
-		int condition_value = globals->pop_var().intValue;
+		Stats::CountNode("IF");
+		int condition_value = condition->evaluate(globals).intValue;
 		if (condition_value != 0)
 		{
 			for (auto statment : statements)
 			{
-				statment->eval(globals);
+				statment->exec(globals);
 			}
 		}
 		else
 		{
 			for (auto else_statment : else_statements)
 			{
-				else_statment->eval(globals);
+				else_statment->exec(globals);
 			}
 		}
 	}
 };
 
-class ASSERT : public TreeNode
+class ASSERT : public StatementNode
 {
 public:
-	ASSERT(TreeNode* condition, TreeNode* str) : condition(condition), str(str) {}
+	ASSERT(ExpressionNode* condition, ExpressionNode* str) : condition(condition), str(str) {}
 	virtual ~ASSERT() override = default;
-	TreeNode* condition;
-	TreeNode* str;
+	ExpressionNode* condition;
+	ExpressionNode* str;
 public:
 	virtual void print() override {
 		std::cout << "ASSERT ("; 
@@ -1055,31 +1375,34 @@ public:
 		std::cout << "\'";
 	}
 
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
-		condition->eval(globals);
-		int condition_value = globals->pop_var().intValue;
+		Stats::CountNode("ASSERT");
+		int condition_value = condition->evaluate(globals).intValue;
 		if (condition_value == 0)
 		{
-			str->eval(globals);
-			std::string str_value = globals->pop_var().strValue;
+			std::string str_value = str->evaluate(globals).GetString().str();
 
-			PushConsoleColor(CONSOLE_COLOR::BLUE);
-			std::cout << "Assert condition: ( "; condition->print(); std::cout << " )\n";
-			PopConsoleColor();
+			// The syntax tree only prints to the console, jobs of a batch report the assert message in the summary instead.
+			if (globals->output == &std::cout) {
+				PushConsoleColor(CONSOLE_COLOR::BLUE);
+				std::cout << "Assert condition: ( "; condition->print(); std::cout << " )\n";
+				PopConsoleColor();
+			}
 
 			throw std::invalid_argument("ASSERT FAILED!: " + str_value);
 		}
 	}
 };
 
-class LOOP : public TreeNode
+class LOOP : public StatementNode
 {
 public:
-	LOOP(TreeNode* times, std::vector<TreeNode*> statements) : times(times), statements(statements) {}
+	LOOP(ExpressionNode* times, std::vector<StatementNode*> statements) : times(times), statements(statements) {}
 	virtual ~LOOP() override = default;
-	TreeNode* times;
-	std::vector<TreeNode*> statements;
+	ExpressionNode* times;
+	std::vector<StatementNode*> statements;
+	const Symbol iterSymbol = InternTable::Intern("ITER");
 public:
 	virtual void print() override {
 		std::cout << "LOOP "; times->print(); std::cout << " TIMES : \n";
@@ -1090,36 +1413,39 @@ public:
 		std::cout << "LOOPEND";
 
 	}
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
-		times->eval(globals);
-		int times_value = globals->pop_var().intValue;
+		Stats::CountNode("LOOP");
+		int times_value = times->evaluate(globals).intValue;
 
 		bool doBreak = false;
 		int ITER = 0;
 		for (int i = 0; i < times_value; ++i)
 		{
+			TraceIterationScope iteration(ITER);
 			for (auto statment : statements)
 			{
-				globals->variables["ITER"] = ITER;
-				statment->eval(globals);
+				globals->set_var(iterSymbol) = ITER;
+				statment->exec(globals);
 				if (doBreak || globals->pop_break()) { doBreak = true;  break; }
 			}
 			if (doBreak || globals->pop_break()) { doBreak = true;  break; }
 
 			++ITER;
 		}
-		globals->variables.erase("ITER");
+		globals->erase_var(iterSymbol);
 	}
 };
 
-class LOOP_ITERATOR : public TreeNode
+class LOOP_ITERATOR : public StatementNode
 {
 public:
-	LOOP_ITERATOR(TreeNode* id, std::vector<TreeNode*> statements) : id(id), statements(statements) {}
+	LOOP_ITERATOR(ID* id, std::vector<StatementNode*> statements) : id(id), statements(statements) {}
 	virtual ~LOOP_ITERATOR() override = default;
-	TreeNode* id;
-	std::vector<TreeNode*> statements;
+	ID* id;
+	std::vector<StatementNode*> statements;
+	const Symbol iterSymbol = InternTable::Intern("ITER");
+	const Symbol charSymbol = InternTable::Intern("CHAR");
 public:
 	virtual void print() override {
 		std::cout << "LOOP "; id->print(); std::cout << " CHARS : \n";
@@ -1130,95 +1456,95 @@ public:
 		std::cout << "LOOPEND";
 
 	}
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
-		std::string id_name = reinterpret_cast<ID*>(id)->str;
-		if (globals->lists.find(id_name) != globals->lists.end())
+		Stats::CountNode("LOOP_ITERATOR");
+		StackVariable var = id->evaluate(globals);
+		if (var.type != VariableType::STRING) {
+			RuntimeError(VariableTypeToString(var.type) + " can't be used as an iterator");
+		}
+		// var is a copy, the loop body may reassign the variable while iterating over it.
+		StringRef value = var.GetString();
+
+		bool doBreak = false;
+		int ITER = 0;
+		for (auto& CHAR : value)
 		{
-			List* list = globals->lists[id_name];
-			bool doBreak = false;
-			int ITER = 0;
-			for (StackVariable& var : list->list)
+			TraceIterationScope iteration(ITER);
+			for (auto statment : statements)
 			{
-				switch (list->type)
-				{
-				case VariableType::INTEGER:
-					{
-						for (auto statment : statements)
-						{
-							globals->variables["CHAR"] = StackVariable(var.intValue);
-							globals->variables["ITER"] = ITER;
-							statment->eval(globals);
-							if (doBreak || globals->pop_break()) { doBreak = true;  break; }
-						}
-					}
-					break;
-				case VariableType::STRING:
-					{
-						for (auto statment : statements)
-						{
-							globals->variables["CHAR"] = StackVariable(var.strValue);
-							globals->variables["ITER"] = ITER;
-							statment->eval(globals);
-							if (doBreak || globals->pop_break()) { doBreak = true;  break; }
-						}
-					}
-					break;
-				case VariableType::FLOAT:
-					{
-						for (auto statment : statements)
-						{
-							globals->variables["CHAR"] = StackVariable(var.fltValue);
-							globals->variables["ITER"] = ITER;
-							statment->eval(globals);
-							if (doBreak || globals->pop_break()) { doBreak = true;  break; }
-						}
-					}
-					break;
-				default:
-					break;
-				}
+				globals->set_var(charSymbol) = StackVariable(InternTable::SingleChar(CHAR));
+				globals->set_var(iterSymbol) = ITER;
+				statment->exec(globals);
 				if (doBreak || globals->pop_break()) { doBreak = true;  break; }
-				++ITER;
 			}
-			globals->variables.erase("CHAR");
-			globals->variables.erase("ITER");
+			if (doBreak || globals->pop_break()) { doBreak = true;  break; }
+
+			++ITER;
 		}
-		else {
-			id->eval(globals);
-			StackVariable var = globals->pop_var();
-			if (var.type != VariableType::STRING) {
-				RuntimeError(VariableTypeToString(var.type) + " can't be used as an iterator");
-			}
-			std::string value = var.strValue;
+		globals->erase_var(charSymbol);
+		globals->erase_var(iterSymbol);
+	}
+};
 
-			bool doBreak = false;
-			int ITER = 0;
-			for (auto& CHAR : value)
+class LOOP_LIST : public StatementNode
+{
+public:
+	LOOP_LIST(ID* id, int listSlot, std::vector<StatementNode*> statements) : id(id), listSlot(listSlot), statements(statements) {}
+	virtual ~LOOP_LIST() override = default;
+	ID* id;
+	int listSlot;
+	std::vector<StatementNode*> statements;
+	const Symbol iterSymbol = InternTable::Intern("ITER");
+	const Symbol charSymbol = InternTable::Intern("CHAR");
+public:
+	virtual void print() override {
+		std::cout << "LOOP "; id->print(); std::cout << " CHARS : \n";
+		for (auto statment : statements)
+		{
+			statment->print();
+		}
+		std::cout << "LOOPEND";
+
+	}
+	virtual void exec(RuntimeGlobals* globals) override
+	{
+		Stats::CountNode("LOOP_LIST");
+		List* list = globals->get_list(listSlot, id->str);
+
+		// Iterate by index over the elements the list had when the loop started,
+		// the loop body may add to the list and reallocate its storage.
+		size_t size = list->size();
+		bool doBreak = false;
+		int ITER = 0;
+		for (size_t i = 0; i < size && i < list->size(); ++i)
+		{
+			TraceIterationScope iteration(ITER);
+			StackVariable CHAR = list->get_var(i);
+			for (auto statment : statements)
 			{
-				for (auto statment : statements)
-				{
-					globals->variables["CHAR"] = StackVariable(std::string(1, CHAR));
-					globals->variables["ITER"] = ITER;
-					statment->eval(globals);
-					if (doBreak || globals->pop_break()) { doBreak = true;  break; }
-				}
+				globals->set_var(charSymbol) = CHAR;
+				globals->set_var(iterSymbol) = ITER;
+				statment->exec(globals);
 				if (doBreak || globals->pop_break()) { doBreak = true;  break; }
-
-				++ITER;
 			}
-			globals->variables.erase("CHAR");
-			globals->variables.erase("ITER");
+			if (doBreak || globals->pop_break()) { doBreak = true;  break; }
+
+			++ITER;
 		}
+		globals->erase_var(charSymbol);
+		globals->erase_var(iterSymbol);
 	}
 };
 
-class LOOP_DAY : public TreeNode
+class LOOP_DAY : public StatementNode
 {
 public:
-	LOOP_DAY(std::vector<TreeNode*> statements) : statements(statements) {}
+	LOOP_DAY(std::vector<StatementNode*> statements) : statements(statements) {}
 	virtual ~LOOP_DAY() override = default;
-	std::vector<TreeNode*> statements;
+	std::vector<StatementNode*> statements;
+	const Symbol iterSymbol = InternTable::Intern("ITER");
+	const Symbol lineSymbol = InternTable::Intern("LINE");
 public:
 	virtual void print() override {
 		std::cout << "LOOP DAY LINES : \n";
@@ -1229,56 +1555,99 @@ public:
 		std::cout << "LOOPEND";
 
 	}
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
+	{
+		Stats::CountNode("LOOP_DAY");
+		prepare(globals);
+		execLines(globals, 0, globals->DayLineCount());
+	}
+
+	// Sets up what the body needs before any line runs.
+	virtual void prepare(RuntimeGlobals* /*globals*/) {}
+
+	// Runs the body for the lines [first, last) of the Day input, ITER is the index of the line. Returns false if the loop was broken out of.
+	bool execLines(RuntimeGlobals* globals, size_t first, size_t last)
 	{
 		bool doBreak = false;
-		int ITER = 0;
-		for (auto& LINE : globals->DayLines)
+		// LINE points into the input, a load in the body mustn't free it while the loop runs.
+		std::shared_ptr<const LoadedInput> input = globals->DayInput;
+		last = std::min(last, input != nullptr ? input->LineCount() : 0);
+		for (size_t ITER = first; ITER < last; ++ITER)
 		{
+			TraceIterationScope iteration(static_cast<int>(ITER));
+			StringRef LINE = input->Line(ITER);
+			beginLine(globals, LINE, static_cast<int>(ITER));
 			for (auto statment : statements)
 			{
-				globals->variables["LINE"] = StackVariable(LINE);
-				globals->variables["ITER"] = ITER;
-				statment->eval(globals);
+				globals->set_var(lineSymbol) = StackVariable::Line(LINE);
+				globals->set_var(iterSymbol) = static_cast<int>(ITER);
+				statment->exec(globals);
 				if (doBreak || globals->pop_break()) { doBreak = true;  break; }
 			}
 			if (doBreak || globals->pop_break()) { doBreak = true;  break; }
+		}
+		globals->erase_var(lineSymbol);
+		globals->erase_var(iterSymbol);
+		return !doBreak;
+	}
 
-			++ITER;
+protected:
+	virtual void beginLine(RuntimeGlobals* /*globals*/, StringRef /*line*/, int /*iter*/) {}
+};
+
+// 'loop DAY rows into INTEGER list row', the list holds the integers of the current line.
+class LOOP_DAY_ROWS : public LOOP_DAY
+{
+public:
+	LOOP_DAY_ROWS(LIST_CREATE* row, std::vector<StatementNode*> statements) : LOOP_DAY(statements), row(row) {}
+	virtual ~LOOP_DAY_ROWS() override = default;
+	LIST_CREATE* row;
+public:
+	virtual void print() override {
+		std::cout << "LOOP DAY ROWS INTO "; row->id->print(); std::cout << " : \n";
+		for (auto statment : statements)
+		{
+			statment->print();
 		}
-		globals->variables.erase("LINE");
-		globals->variables.erase("ITER");
+		std::cout << "LOOPEND";
 	}
+	virtual void prepare(RuntimeGlobals* globals) override { row->exec(globals); }
+
+protected:
+	virtual void beginLine(RuntimeGlobals* globals, StringRef line, int iter) override;
 };
 
-class BREAK : public TreeNode
+class BREAK : public StatementNode
 {
 public:
 	BREAK() {}
 	virtual ~BREAK() override = default;
 public:
 	virtual void print() override { std::cout << "BREAK"; }
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual void exec(RuntimeGlobals* globals) override
 	{
+		Stats::CountNode("BREAK");
 		globals->push_break();
 	}
 };
 
-class STRING : public TreeNode
+class STRING : public ExpressionNode
 {
 public:
-	STRING(std::string str) : str(str) {}
+	STRING(std::string str) : str(str), interned(InternTable::InternString(str)) {}
 	virtual ~STRING() override = default;
 	std::string str;
+	const std::string* interned;
 public:
 	virtual void print() override { std::cout << str; }
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual StackVariable evaluate(RuntimeGlobals* /*globals*/) override
 	{
-		globals->push_var(str);
+		Stats::CountNode("STRING");
+		return StackVariable(interned);
 	}
 };
 
-class INTEGER : public TreeNode
+class INTEGER : public ExpressionNode
 {
 public:
 	INTEGER(int num) : num(num) {}
@@ -1286,13 +1655,14 @@ public:
 	int num;
 public:
 	virtual void print() override { std::cout << num; }
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual StackVariable evaluate(RuntimeGlobals* /*globals*/) override
 	{
-		globals->push_var(num);
+		Stats::CountNode("INTEGER");
+		return num;
 	}
 };
 
-class FLOAT : public TreeNode
+class FLOAT : public ExpressionNode
 {
 public:
 	FLOAT(float num) : num(num) {}
@@ -1300,41 +1670,68 @@ public:
 	float num;
 public:
 	virtual void print() override { std::cout << num; }
-	virtual void eval(RuntimeGlobals* globals) override
+	virtual StackVariable evaluate(RuntimeGlobals* /*globals*/) override
 	{
-		globals->push_var(num);
+		Stats::CountNode("FLOAT");
+		return num;
 	}
 };
 
+class ListExpressionNode; // See ListExpressions.h
+class Optimizer; // See Optimizer.h
+
 class Parser
 {
 //	See grammar in README.md 
 public:
+	// Runs every statement right after it is parsed, statements before a syntax error have already run.
 	Parser(std::string code, bool printSyntax);
+	// Only parses the program, it can then be run any number of times with Run. Throws on syntax errors.
+	explicit Parser(std::string code);
 	~Parser();
 	TreeNode* getAST() { return ast; };
+
+	// The parsed statements don't hold any runtime state, so programs can run on several threads with their own globals.
+	void Run(RuntimeGlobals* runGlobals);
+
+	// Top level statements one at a time, --watch keeps the globals after a prefix of them and runs only the rest again.
+	size_t StatementCount() const { return statements.size(); }
+	uint64_t StatementHash(size_t index) const { return statementHashes[index]; } // Same tokens, same hash.
+	int StatementLine(size_t index) const;
+	void RunStatement(size_t index, RuntimeGlobals* runGlobals);
 private:
-	bool ScanExpression(Token t, TreeNode** outNode);
-	bool ScanLogic(Token t, TreeNode** outNode);
-	bool ScanTerm(Token t, TreeNode** outNode);
-	bool ScanFactor(Token t, TreeNode** outNode);
-	bool ScanNegate(Token t, TreeNode** outNode);
-	bool ScanAssignment(Token t, TreeNode** outNode);
-	bool ScanListDeclaration(Token t, TreeNode** outNode);
-	bool ScanID(Token t, TreeNode** outNode);
-	bool ScanBreak(Token t, TreeNode** outNode);
-	bool ScanString(Token t, TreeNode** outNode);
-	bool ScanPrint(Token t, TreeNode** outNode);
-	bool ScanLoad(Token t, TreeNode** outNode);
-	bool ScanIf(Token t, TreeNode** outNode);
-	bool ScanLoop(Token t, TreeNode** outNode);
-	bool ScanAssert(Token t, TreeNode** outNode);
-	bool ScanStatement(Token t, TreeNode** outNode, bool programStatement = true);
+	bool ScanProgramStatement(Optimizer& optimizer, StatementNode** outNode);
+	bool ScanExpression(Token t, ExpressionNode** outNode);
+	bool ScanLogic(Token t, ExpressionNode** outNode);
+	bool ScanTerm(Token t, ExpressionNode** outNode);
+	bool ScanFactor(Token t, ExpressionNode** outNode);
+	bool ScanNegate(Token t, ExpressionNode** outNode);
+	bool ScanListExpression(Token t, ListExpressionNode** outNode);
+	bool ScanListTerm(Token t, ListExpressionNode** outNode);
+	bool ScanListOperand(Token t, ListExpressionNode** outNode);
+	bool ScanAssignment(Token t, StatementNode** outNode);
+	bool ScanListDeclaration(Token t, StatementNode** outNode);
+	LIST_CREATE* DeclareList(Token t, ID* id, bool isSorted, VariableType type);
+	bool ScanLoadInto(Token t, bool& isSorted);
+	bool ScanSort(Token t, StatementNode** outNode);
+	bool ScanID(Token t, ID** outNode);
+	bool IsKeywordBeforeValue(Token t, const char* keyword);
+	bool ScanBreak(Token t, StatementNode** outNode);
+	bool ScanString(Token t, ExpressionNode** outNode);
+	bool ScanPrint(Token t, StatementNode** outNode);
+	bool ScanLoad(Token t, StatementNode** outNode);
+	bool ScanIf(Token t, StatementNode** outNode);
+	bool ScanLoop(Token t, StatementNode** outNode, bool parallel = false);
+	bool ScanParallel(Token t, StatementNode** outNode);
+	bool ScanAssert(Token t, StatementNode** outNode);
+	bool ScanStatement(Token t, StatementNode** outNode, bool programStatement = true);
+	int GetListSlot(ID* id);
 
 	RuntimeGlobals globals;
 	Tokenizer tokenizer;
 	TreeNode* ast;
 	std::vector<TreeNode*> nodes;
-	std::vector<TreeNode*> statements;
-	std::map<std::string, char> declaredLists;
+	std::vector<StatementNode*> statements;
+	std::vector<uint64_t> statementHashes;
+	std::map<std::string, int> declaredLists; // List name to its slot in RuntimeGlobals::lists.
 };
\ No newline at end of file
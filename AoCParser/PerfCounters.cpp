@@ -0,0 +1,189 @@
+#include "PerfCounters.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <vector>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+bool PerfCounters::enabled = false;
+
+enum PerfEvent
+{
+	CYCLES,
+	INSTRUCTIONS,
+	CACHE_REFERENCES,
+	CACHE_MISSES,
+	BRANCHES,
+	BRANCH_MISSES,
+	EVENT_COUNT
+};
+
+using PerfClock = std::chrono::steady_clock;
+
+struct PerfSample
+{
+	double values[EVENT_COUNT] = {};
+	double milliseconds = 0.0;
+
+	void add(const PerfSample& begin, const PerfSample& end) {
+		for (int i = 0; i < EVENT_COUNT; i++)
+		{
+			values[i] += end.values[i] - begin.values[i];
+		}
+		milliseconds += end.milliseconds - begin.milliseconds;
+	}
+};
+
+static int Descriptors[EVENT_COUNT] = { -1, -1, -1, -1, -1, -1 };
+static bool Available = false;
+static std::string Unavailable = "";
+static PerfSample PhaseStart;
+static PerfSample Phases[static_cast<int>(StatPhase::COUNT)];
+static PerfSample StatementStart;
+static std::vector<int> StatementOrder;
+static std::map<int, PerfSample> Statements;
+
+static const PerfClock::time_point Origin = PerfClock::now();
+
+static PerfSample Read()
+{
+	PerfSample sample;
+	sample.milliseconds = std::chrono::duration<double, std::milli>(PerfClock::now() - Origin).count();
+#if defined(__linux__)
+	for (int i = 0; i < EVENT_COUNT && Available; i++)
+	{
+		unsigned long long values[3] = {}; // Count, time enabled and time running.
+		if (Descriptors[i] >= 0 && read(Descriptors[i], values, sizeof(values)) == sizeof(values) && values[2] > 0) {
+			sample.values[i] = static_cast<double>(values[0]) * values[1] / values[2];
+		}
+	}
+#endif
+	return sample;
+}
+
+void PerfCounters::Open()
+{
+#if defined(__linux__)
+	static const unsigned long long configs[EVENT_COUNT] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_REFERENCES,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	for (int i = 0; i < EVENT_COUNT; i++)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.inherit = 1; // Threads started later, e.g. by parallel loops, are added when they exit.
+		// The counters are multiplexed when there are more than the CPU has, the counts are scaled by the time they ran.
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		Descriptors[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		if (Descriptors[i] >= 0) {
+			Available = true;
+		}
+		else if (Unavailable.empty()) {
+			Unavailable = std::strerror(errno);
+		}
+	}
+
+	if (!Available) {
+		Unavailable += ", see /proc/sys/kernel/perf_event_paranoid";
+	}
+#else
+	Unavailable = "perf_event_open is only available on Linux";
+#endif
+	PhaseStart = Read();
+}
+
+void PerfCounters::SwitchPhase(StatPhase from)
+{
+	PerfSample now = Read();
+	Phases[static_cast<int>(from)].add(PhaseStart, now);
+	PhaseStart = now;
+}
+
+void PerfCounters::BeginStatement()
+{
+	StatementStart = Read();
+}
+
+void PerfCounters::EndStatement(int profileId)
+{
+	PerfSample now = Read();
+	if (Statements.find(profileId) == Statements.end()) {
+		StatementOrder.push_back(profileId);
+	}
+	Statements[profileId].add(StatementStart, now);
+}
+
+static void PrintRow(std::ostream& out, const std::string& name, const PerfSample& sample)
+{
+	auto ratio = [](double numerator, double denominator) { return denominator > 0.0 ? numerator / denominator : 0.0; };
+	out << std::left << std::setw(24) << name << std::right << std::setw(12) << sample.milliseconds;
+	if (Available) {
+		const double* values = sample.values;
+		out << std::setw(16) << std::setprecision(0) << values[CYCLES] << std::setw(16) << values[INSTRUCTIONS] << std::setprecision(2)
+			<< std::setw(8) << ratio(values[INSTRUCTIONS], values[CYCLES])
+			<< std::setw(10) << 100.0 * ratio(values[CACHE_MISSES], values[CACHE_REFERENCES])
+			<< std::setw(10) << 100.0 * ratio(values[BRANCH_MISSES], values[BRANCHES]);
+	}
+	out << "\n";
+}
+
+void PerfCounters::PrintReport(std::ostream& out)
+{
+	const size_t maxRows = 25;
+
+	out << std::fixed << std::setprecision(2);
+	out << "Perf counters:\n";
+	if (!Available) {
+		out << "  Not available (" << Unavailable << "), only wall-clock time is reported.\n";
+	}
+	out << std::left << std::setw(24) << "  phase" << std::right << std::setw(12) << "ms";
+	if (Available) {
+		out << std::setw(16) << "cycles" << std::setw(16) << "instructions" << std::setw(8) << "IPC" << std::setw(10) << "cache%" << std::setw(10) << "branch%";
+	}
+	out << "\n";
+	for (StatPhase phase : { StatPhase::TOKENIZE, StatPhase::PARSE, StatPhase::EXECUTE })
+	{
+		static const char* names[] = { "", "  tokenize", "  parse", "  execute" };
+		PrintRow(out, names[static_cast<int>(phase)], Phases[static_cast<int>(phase)]);
+	}
+
+	// Sorted by cycles, or by time when there are no counters.
+	std::vector<int> statements = StatementOrder;
+	std::stable_sort(statements.begin(), statements.end(), [](int a, int b) {
+		const PerfSample& left = Statements[a];
+		const PerfSample& right = Statements[b];
+		return Available ? left.values[CYCLES] > right.values[CYCLES] : left.milliseconds > right.milliseconds;
+	});
+
+	out << "\nTop level statements:\n";
+	for (size_t i = 0; i < statements.size() && i < maxRows; i++)
+	{
+		int id = statements[i];
+		std::string name = "  L" + std::to_string(Profiler::Line(id)) + " " + Profiler::Source(id);
+		if (name.length() > 23) {
+			name = name.substr(0, 20) + "...";
+		}
+		PrintRow(out, name, Statements[id]);
+	}
+	out << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Stats.h"
+#include <string>
+#include <iostream>
+
+// Hardware counters for the tokenize, parse and execute phases and for every top level statement, enabled with --perf-counters.
+// Cycles, instructions, cache and branch misses are read with perf_event_open on Linux, the threads of parallel loops are included.
+// When the counters can't be opened, e.g. in a container where perf events aren't permitted or on other platforms,
+// only the wall-clock time is reported.
+class PerfCounters
+{
+public:
+	static bool enabled;
+
+	// Opens the counters, called once before the script is parsed.
+	static void Open();
+
+	// Called by Stats::SwitchPhase, the counts since the last switch are added to the phase that was running.
+	static void SwitchPhase(StatPhase from);
+	static void BeginStatement();
+	static void EndStatement(int profileId);
+
+	// IPC and miss rates of the phases followed by the top level statements with the most cycles.
+	static void PrintReport(std::ostream& out);
+};
+
+class PerfStatementScope
+{
+public:
+	PerfStatementScope(int profileId) : profileId(PerfCounters::enabled ? profileId : -1) {
+		if (this->profileId >= 0) { PerfCounters::BeginStatement(); }
+	}
+	~PerfStatementScope() { if (profileId >= 0) { PerfCounters::EndStatement(profileId); } }
+private:
+	int profileId;
+};
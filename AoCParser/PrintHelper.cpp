@@ -2,70 +2,152 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #if defined(_WIN32)
 // To enable color output in windows CMD with ANSI escape code
 #include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
 #endif
 
-static std::vector<CONSOLE_COLOR> ColorStack = {};
+// Each thread has its own stack, colors pushed by one thread never leak into the output of another.
+static thread_local std::vector<CONSOLE_COLOR> ColorStack = {};
+
+// Escape codes are only written to a terminal, and never when NO_COLOR is set (https://no-color.org).
+static bool ColorsEnabled = true;
 
 void InitializePrintHelper()
 {
+	const char* noColor = std::getenv("NO_COLOR");
 #if defined(_WIN32)
+	ColorsEnabled = _isatty(_fileno(stdout)) && (noColor == nullptr || noColor[0] == '\0');
+	if (!ColorsEnabled) {
+		return;
+	}
+
 	// Enable virtual terminal processing (to support ANSI escape codes)
 	HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
 	DWORD dwMode = 0;
 	GetConsoleMode(hOut, &dwMode);
 	dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
 	SetConsoleMode(hOut, dwMode);
+#else
+	ColorsEnabled = isatty(fileno(stdout)) && (noColor == nullptr || noColor[0] == '\0');
 #endif
 }
 
-std::string ConsoleColorToString(CONSOLE_COLOR color) {
-	const std::string WHITE = "\033[37m";
-	const std::string RED = "\033[91m";
-	const std::string GREEN = "\033[92m";
-	const std::string YELLOW = "\033[93m";
+void SetColorsEnabled(bool enabled)
+{
+	ColorsEnabled = enabled;
+}
+
+bool GetColorsEnabled()
+{
+	return ColorsEnabled;
+}
 
-	// Custom light blue using RGB (e.g., R=50, G=80, B=255) since "\033[94m" is very dark and unreadable
-	const std::string BLUE = "\033[38;2;50;80;255m";
-	const std::string MAGENTA = "\033[95m";
-	const std::string CYAN = "\033[96m";
-	const std::string RESET = "\033[0m";
+const char* ConsoleColorToString(CONSOLE_COLOR color) {
+	if (!ColorsEnabled) {
+		return "";
+	}
 
-	std::string result = RESET;
 	switch (color) {
 	case CONSOLE_COLOR::WHITE:
-		result = WHITE;
-		break;
+		return "\033[37m";
 	case CONSOLE_COLOR::RED:
-		result = RED;
-		break;
+		return "\033[91m";
 	case CONSOLE_COLOR::YELLOW:
-		result = YELLOW;
-		break;
+		return "\033[93m";
 	case CONSOLE_COLOR::GREEN:
-		result = GREEN;
-		break;
+		return "\033[92m";
 	case CONSOLE_COLOR::BLUE:
-		result = BLUE;
-		break;
+		// Custom light blue using RGB (e.g., R=50, G=80, B=255) since "\033[94m" is very dark and unreadable
+		return "\033[38;2;50;80;255m";
 	case CONSOLE_COLOR::MAGENTA:
-		result = MAGENTA;
-		break;
+		return "\033[95m";
 	case CONSOLE_COLOR::CYAN:
-		result = CYAN;
-		break;
+		return "\033[96m";
 	default:
-		break;
+		return "\033[0m";
+	}
+}
+
+// Returns the color a color name starting at text begins, or RESET if no color name starts there.
+// No name is a prefix of another and no name starts inside a name that used to be replaced before it,
+// so coloring every start in one pass gives the same result as replacing the names one at a time (e.g. "YELLOWHITE").
+static CONSOLE_COLOR MatchColorName(const char* text, size_t length, size_t& nameLength)
+{
+	struct ColorName {
+		const char* name;
+		size_t length;
+		CONSOLE_COLOR color;
+	};
+	static const ColorName names[] = {
+		{ "FAILED", 6, CONSOLE_COLOR::RED },
+		{ "SUCCESS", 7, CONSOLE_COLOR::GREEN },
+		{ "RED", 3, CONSOLE_COLOR::RED },
+		{ "YELLOW", 6, CONSOLE_COLOR::YELLOW },
+		{ "GREEN", 5, CONSOLE_COLOR::GREEN },
+		{ "BLUE", 4, CONSOLE_COLOR::BLUE },
+		{ "MAGENTA", 7, CONSOLE_COLOR::MAGENTA },
+		{ "CYAN", 4, CONSOLE_COLOR::CYAN },
+		{ "WHITE", 5, CONSOLE_COLOR::WHITE },
+	};
+
+	const ColorName* candidate = nullptr;
+	switch (text[0]) {
+	case 'F': candidate = &names[0]; break;
+	case 'S': candidate = &names[1]; break;
+	case 'R': candidate = &names[2]; break;
+	case 'Y': candidate = &names[3]; break;
+	case 'G': candidate = &names[4]; break;
+	case 'B': candidate = &names[5]; break;
+	case 'M': candidate = &names[6]; break;
+	case 'C': candidate = &names[7]; break;
+	case 'W': candidate = &names[8]; break;
+	default: return CONSOLE_COLOR::RESET;
+	}
+
+	if (candidate->length <= length && std::memcmp(text, candidate->name, candidate->length) == 0) {
+		nameLength = candidate->length;
+		return candidate->color;
 	}
-	return result;
+	return CONSOLE_COLOR::RESET;
+}
+
+void WriteColorized(std::ostream& out, StringRef str)
+{
+	if (!ColorsEnabled) {
+		out << str;
+		return;
+	}
+
+	// Text between color names is written in one piece straight from str.
+	const char* text = str.data();
+	size_t length = str.length();
+	size_t written = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		size_t nameLength = 0;
+		CONSOLE_COLOR color = MatchColorName(text + i, length - i, nameLength);
+		if (color != CONSOLE_COLOR::RESET) {
+			out.write(text + written, i - written);
+			out << ConsoleColorToString(color);
+			written = i;
+		}
+	}
+	out.write(text + written, length - written);
 }
 
 void PushConsoleColor(CONSOLE_COLOR color) {
 	ColorStack.push_back(color);
-	std::cout << ConsoleColorToString(color);
+	if (ColorsEnabled) {
+		std::cout << ConsoleColorToString(color);
+	}
 }
 
 void PopConsoleColor() {
@@ -76,9 +158,38 @@ void PopConsoleColor() {
 			color = ColorStack.back();
 		}
 	}
-	std::cout << ConsoleColorToString(color);
+	if (ColorsEnabled) {
+		std::cout << ConsoleColorToString(color);
+	}
 }
 
 void ResetConsoleColor() {
-	std::cout << ConsoleColorToString(CONSOLE_COLOR::RESET);
-}
\ No newline at end of file
+	if (ColorsEnabled) {
+		std::cout << ConsoleColorToString(CONSOLE_COLOR::RESET);
+	}
+}
+
+std::string JsonString(const std::string& str)
+{
+	std::string result = "\"";
+	for (char c : str)
+	{
+		switch (c) {
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				result += escaped;
+			}
+			else {
+				result += c;
+			}
+		}
+	}
+	return result + "\"";
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include "StringRef.h"
 #include <string>
+#include <ostream>
 
 enum class CONSOLE_COLOR {
 	WHITE,
@@ -12,9 +14,19 @@ enum class CONSOLE_COLOR {
 	RESET,
 };
 
-std::string ConsoleColorToString(CONSOLE_COLOR color);
+// Returns the empty string when colors are disabled.
+const char* ConsoleColorToString(CONSOLE_COLOR color);
+// Writes str with every color name in it (e.g. "RED", "SUCCESS") preceded by its color.
+void WriteColorized(std::ostream& out, StringRef str);
 void PushConsoleColor(CONSOLE_COLOR color);
 void PopConsoleColor();
 void ResetConsoleColor();
 
-void InitializePrintHelper();
\ No newline at end of file
+// Quoted, with the characters JSON doesn't allow in strings escaped.
+std::string JsonString(const std::string& str);
+
+// Colors are disabled when stdout isn't a terminal or NO_COLOR is set.
+void InitializePrintHelper();
+// The server always writes colors, its clients remove them when their own output has colors disabled.
+void SetColorsEnabled(bool enabled);
+bool GetColorsEnabled();
\ No newline at end of file
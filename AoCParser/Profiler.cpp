@@ -0,0 +1,182 @@
+#include "Profiler.h"
+#include <chrono>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+using ProfileClock = std::chrono::steady_clock;
+
+struct ProfileEntry
+{
+	int line;
+	std::string source;
+	long long count;
+	ProfileClock::duration inclusive;
+	ProfileClock::duration exclusive;
+};
+
+// Node in the tree of statement call stacks, index 0 is the root.
+struct CallNode
+{
+	int entry;
+	int parent;
+	std::map<int, int> children; // Entry id to call node index.
+	ProfileClock::duration exclusive;
+};
+
+struct ProfileFrame
+{
+	int callNode;
+	ProfileClock::time_point start;
+	ProfileClock::duration children;
+};
+
+bool Profiler::enabled = false;
+
+static std::vector<ProfileEntry> Entries = {};
+static std::vector<CallNode> CallTree = { CallNode{ -1, -1, {}, ProfileClock::duration::zero() } };
+static std::vector<ProfileFrame> Frames = {};
+
+static double ToMilliseconds(ProfileClock::duration duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+int Profiler::Register(int line, const std::string& source)
+{
+	// Only keep the first statement on the line and nothing that would break the folded format.
+	std::string label = source.substr(0, source.find(';'));
+	std::replace(label.begin(), label.end(), '\t', ' ');
+	label.erase(0, label.find_first_not_of(' '));
+	if (label.length() > 60) {
+		label = label.substr(0, 57) + "...";
+	}
+
+	Entries.push_back(ProfileEntry{ line, label, 0, ProfileClock::duration::zero(), ProfileClock::duration::zero() });
+	return static_cast<int>(Entries.size()) - 1;
+}
+
+int Profiler::Line(int id)
+{
+	return Entries[id].line;
+}
+
+const std::string& Profiler::Source(int id)
+{
+	return Entries[id].source;
+}
+
+void Profiler::Enter(int id)
+{
+	int parent = Frames.empty() ? 0 : Frames.back().callNode;
+	int callNode = 0;
+	auto found = CallTree[parent].children.find(id);
+	if (found != CallTree[parent].children.end()) {
+		callNode = found->second;
+	}
+	else {
+		callNode = static_cast<int>(CallTree.size());
+		CallTree.push_back(CallNode{ id, parent, {}, ProfileClock::duration::zero() });
+		CallTree[parent].children[id] = callNode;
+	}
+
+	Frames.push_back(ProfileFrame{ callNode, ProfileClock::now(), ProfileClock::duration::zero() });
+}
+
+void Profiler::Exit(int id)
+{
+	ProfileClock::time_point end = ProfileClock::now();
+	ProfileFrame frame = Frames.back();
+	Frames.pop_back();
+
+	ProfileClock::duration inclusive = end - frame.start;
+	ProfileClock::duration exclusive = inclusive - frame.children;
+
+	// A statement can't contain itself, so the inclusive time is never counted twice.
+	ProfileEntry& entry = Entries[id];
+	++entry.count;
+	entry.inclusive += inclusive;
+	entry.exclusive += exclusive;
+	CallTree[frame.callNode].exclusive += exclusive;
+
+	if (!Frames.empty()) {
+		Frames.back().children += inclusive;
+	}
+}
+
+void Profiler::PrintReport(std::ostream& out)
+{
+	const size_t maxRows = 25;
+
+	ProfileClock::duration total = ProfileClock::duration::zero();
+	std::vector<int> executed;
+	for (int i = 0; i < static_cast<int>(Entries.size()); i++) {
+		if (Entries[i].count > 0) {
+			executed.push_back(i);
+			total += Entries[i].exclusive;
+		}
+	}
+	std::sort(executed.begin(), executed.end(), [](int a, int b) { return Entries[a].exclusive > Entries[b].exclusive; });
+
+	double totalMs = ToMilliseconds(total);
+	auto percent = [totalMs](ProfileClock::duration duration) {
+		return totalMs > 0.0 ? 100.0 * ToMilliseconds(duration) / totalMs : 0.0;
+	};
+
+	out << std::fixed << std::setprecision(2);
+	out << "Profile: " << totalMs << " ms in " << executed.size() << " statements\n";
+	out << std::setw(6) << "line" << std::setw(12) << "count" << std::setw(14) << "incl ms" << std::setw(14) << "excl ms" << std::setw(8) << "excl%" << "  statement\n";
+	for (size_t i = 0; i < executed.size() && i < maxRows; i++) {
+		const ProfileEntry& entry = Entries[executed[i]];
+		out << std::setw(6) << entry.line << std::setw(12) << entry.count
+			<< std::setw(14) << ToMilliseconds(entry.inclusive) << std::setw(14) << ToMilliseconds(entry.exclusive)
+			<< std::setw(8) << percent(entry.exclusive) << "  " << entry.source << "\n";
+	}
+
+	// Several statements can share a line, e.g. 'if a: break; else:end;'.
+	std::map<int, ProfileClock::duration> lines;
+	for (int id : executed) {
+		lines[Entries[id].line] += Entries[id].exclusive;
+	}
+	std::vector<std::pair<int, ProfileClock::duration>> hotLines(lines.begin(), lines.end());
+	std::sort(hotLines.begin(), hotLines.end(), [](const std::pair<int, ProfileClock::duration>& a, const std::pair<int, ProfileClock::duration>& b) {
+		return a.second > b.second;
+	});
+
+	out << "\nHot lines:\n";
+	out << std::setw(6) << "line" << std::setw(14) << "excl ms" << std::setw(8) << "excl%" << "\n";
+	for (size_t i = 0; i < hotLines.size() && i < maxRows; i++) {
+		out << std::setw(6) << hotLines[i].first << std::setw(14) << ToMilliseconds(hotLines[i].second)
+			<< std::setw(8) << percent(hotLines[i].second) << "\n";
+	}
+	out << std::defaultfloat << std::setprecision(6);
+}
+
+bool Profiler::WriteFoldedStacks(const std::string& filePath, const std::string& rootName)
+{
+	std::ofstream file(filePath);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	for (size_t i = 1; i < CallTree.size(); i++) {
+		long long microseconds = std::chrono::duration_cast<std::chrono::microseconds>(CallTree[i].exclusive).count();
+		if (microseconds <= 0) {
+			continue;
+		}
+
+		std::vector<int> stack;
+		for (int node = static_cast<int>(i); node > 0; node = CallTree[node].parent) {
+			stack.push_back(CallTree[node].entry);
+		}
+
+		file << rootName;
+		for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+			file << ";L" << Entries[*it].line << " " << Entries[*it].source;
+		}
+		file << " " << microseconds << "\n";
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <iostream>
+
+// Execution counts and wall time per statement, enabled with --profile.
+// Statement::exec is the only hook, when disabled profiling costs one branch per executed statement.
+class Profiler
+{
+public:
+	static bool enabled;
+
+	// Called by the parser for every statement, returns the id the statement reports with.
+	static int Register(int line, const std::string& source);
+	static int Line(int id);
+	static const std::string& Source(int id); // First statement on the line, shortened to fit a report.
+
+	static void Enter(int id);
+	static void Exit(int id);
+
+	// Statements sorted by exclusive time followed by the hottest source lines.
+	static void PrintReport(std::ostream& out);
+	// One line per call stack in the folded format read by flamegraph.pl and speedscope, sample values are microseconds.
+	static bool WriteFoldedStacks(const std::string& filePath, const std::string& rootName);
+};
+
+// Exits the statement even when it throws, e.g. on a failed assert.
+class ProfileScope
+{
+public:
+	ProfileScope(int id) : id(id) { Profiler::Enter(id); }
+	~ProfileScope() { Profiler::Exit(id); }
+private:
+	int id;
+};
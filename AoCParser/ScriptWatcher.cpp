@@ -0,0 +1,290 @@
+#include "ScriptWatcher.h"
+#include "Parser.h"
+#include "InputCache.h"
+#include "PrintHelper.h"
+#include <chrono>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+double ScriptWatcher::snapshotMilliseconds = 20.0;
+
+using WatchClock = std::chrono::steady_clock;
+
+// A file a run depends on and its version when it was read.
+struct WatchedFile
+{
+	std::string path;
+	std::string version;
+};
+
+// Globals after the top level statements before next, a run continues from here when none of them changed.
+struct WatchSnapshot
+{
+	size_t next;
+	std::unique_ptr<RuntimeGlobals> globals;
+	std::string output; // Written by the statements before next.
+	std::vector<WatchedFile> inputs; // Read by the statements before next.
+	double milliseconds; // Time the statements before next took.
+};
+
+// Writes to the console and keeps a copy, the output of the statements before a snapshot is written again by the next run.
+class TeeOutput : public std::streambuf
+{
+public:
+	TeeOutput(std::ostream& console, const std::string& written) : console(console), written(written) {}
+	const std::string& Written() const { return written; }
+
+protected:
+	virtual int_type overflow(int_type c) override {
+		if (c != traits_type::eof()) {
+			console.put(static_cast<char>(c));
+			written.push_back(static_cast<char>(c));
+		}
+		return traits_type::not_eof(c);
+	}
+
+	virtual std::streamsize xsputn(const char* s, std::streamsize count) override {
+		console.write(s, count);
+		written.append(s, static_cast<size_t>(count));
+		return count;
+	}
+
+	virtual int sync() override {
+		console.flush();
+		return 0;
+	}
+
+private:
+	std::ostream& console;
+	std::string written;
+};
+
+static std::vector<std::string> Versions(const std::vector<WatchedFile>& files)
+{
+	std::vector<std::string> versions;
+	for (const WatchedFile& file : files)
+	{
+		versions.push_back(InputCache::Version(file.path));
+	}
+	return versions;
+}
+
+static bool Changed(const std::vector<WatchedFile>& files)
+{
+	for (const WatchedFile& file : files)
+	{
+		if (InputCache::Version(file.path) != file.version) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static std::string Directory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "." : path.substr(0, slash + 1);
+}
+
+// Returns once one of the files has a new version that has stopped changing, editors often write a file in more than one step.
+static void WaitForChange(const std::vector<WatchedFile>& files)
+{
+#if defined(__linux__)
+	int notify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (notify >= 0) {
+		std::set<std::string> directories;
+		for (const WatchedFile& file : files)
+		{
+			directories.insert(Directory(file.path));
+		}
+		// Editors that save by renaming a new file over the old one are only seen in the directory.
+		for (const std::string& directory : directories)
+		{
+			inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MODIFY);
+		}
+	}
+#endif
+
+	while (!Changed(files))
+	{
+#if defined(__linux__)
+		if (notify >= 0) {
+			// The timeout also catches changes inotify doesn't report, e.g. on network file systems.
+			pollfd events = { notify, POLLIN, 0 };
+			if (poll(&events, 1, 1000) > 0) {
+				char buffer[4096];
+				while (read(notify, buffer, sizeof(buffer)) > 0) {}
+			}
+			continue;
+		}
+#endif
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	}
+
+#if defined(__linux__)
+	if (notify >= 0) {
+		close(notify);
+	}
+#endif
+
+	std::vector<std::string> settled = Versions(files);
+	std::vector<std::string> versions;
+	do
+	{
+		versions = settled;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		settled = Versions(files);
+	} while (settled != versions);
+}
+
+static void PrintError(const std::string& message)
+{
+	// Everything the script printed comes first.
+	std::cout.flush();
+	PushConsoleColor(CONSOLE_COLOR::RED);
+	std::cerr << message << std::endl;
+	PopConsoleColor();
+}
+
+// ReadFile throws when the file is missing, e.g. while an editor saves by deleting and writing it again.
+static bool ReadScript(const std::string& path, std::string& code)
+{
+	try {
+		return ReadFile(path, code);
+	}
+	catch (const std::invalid_argument& e) {
+		(void)e; // The caller reports the missing file.
+		return false;
+	}
+}
+
+int ScriptWatcher::Run(const std::string& path)
+{
+	std::vector<uint64_t> hashes; // Of the statements of the last program that parsed.
+	std::vector<WatchSnapshot> snapshots;
+	std::vector<WatchedFile> inputs; // Read by the last run.
+	bool first = true;
+	while (true)
+	{
+		std::vector<WatchedFile> watched = inputs;
+		watched.insert(watched.begin(), WatchedFile{ path, InputCache::Version(path) });
+		if (!first) {
+			WaitForChange(watched);
+		}
+
+		std::string code;
+		if (!ReadScript(path, code)) {
+			if (first) {
+				PrintError("File not found: " + path);
+				return 2;
+			}
+			PrintError("File not found: " + path + ", waiting for it to be written again");
+			continue;
+		}
+		first = false;
+
+		PushConsoleColor(CONSOLE_COLOR::CYAN);
+		std::cout << "Run code : " << path << "\n";
+		PopConsoleColor();
+
+		std::unique_ptr<Parser> program;
+		try {
+			program.reset(new Parser(code));
+		}
+		catch (const std::invalid_argument& e) {
+			// The globals of the last program that parsed are still used once the error is fixed.
+			PrintError(e.what());
+			std::cout << "\n\n";
+			std::cout.flush();
+			continue;
+		}
+
+		// Statements are compared by their tokens, the globals after an unchanged prefix are the same as in the last run
+		// unless a file read by it has changed since.
+		size_t unchanged = 0;
+		while (unchanged < hashes.size() && unchanged < program->StatementCount() && hashes[unchanged] == program->StatementHash(unchanged))
+		{
+			unchanged++;
+		}
+		while (!snapshots.empty() && (snapshots.back().next > unchanged || Changed(snapshots.back().inputs)))
+		{
+			snapshots.pop_back();
+		}
+		hashes.clear();
+		for (size_t i = 0; i < program->StatementCount(); i++)
+		{
+			hashes.push_back(program->StatementHash(i));
+		}
+
+		std::unique_ptr<RuntimeGlobals> globals;
+		size_t next = 0;
+		double milliseconds = 0.0;
+		std::string written;
+		inputs.clear();
+		if (!snapshots.empty()) {
+			const WatchSnapshot& snapshot = snapshots.back();
+			globals.reset(new RuntimeGlobals(*snapshot.globals));
+			next = snapshot.next;
+			milliseconds = snapshot.milliseconds;
+			written = snapshot.output;
+			inputs = snapshot.inputs;
+			PushConsoleColor(CONSOLE_COLOR::CYAN);
+			std::cout << "Continuing after the statement on line " << program->StatementLine(next - 1) << ", skipped " << milliseconds << " ms\n";
+			PopConsoleColor();
+			std::cout << written;
+		}
+		else {
+			globals.reset(new RuntimeGlobals());
+		}
+
+		TeeOutput tee(std::cout, written);
+		std::ostream output(&tee);
+		std::vector<std::string> loaded;
+		globals->output = &output;
+		globals->loadedFiles = &loaded;
+		auto addInputs = [&]() {
+			for (const std::string& file : loaded)
+			{
+				inputs.push_back(WatchedFile{ file, InputCache::Version(file) });
+			}
+			loaded.clear();
+		};
+
+		double sinceSnapshot = 0.0;
+		try {
+			for (size_t i = next; i < program->StatementCount(); i++)
+			{
+				WatchClock::time_point start = WatchClock::now();
+				program->RunStatement(i, globals.get());
+				double elapsed = std::chrono::duration<double, std::milli>(WatchClock::now() - start).count();
+				milliseconds += elapsed;
+				sinceSnapshot += elapsed;
+				addInputs();
+
+				if (sinceSnapshot >= snapshotMilliseconds && i + 1 < program->StatementCount()) {
+					snapshots.push_back(WatchSnapshot{ i + 1, std::unique_ptr<RuntimeGlobals>(new RuntimeGlobals(*globals)), tee.Written(), inputs, milliseconds });
+					sinceSnapshot = 0.0;
+				}
+			}
+		}
+		catch (const std::invalid_argument& e) {
+			// A failed statement may still have read a file, a fix to the input runs it again.
+			addInputs();
+			output.flush();
+			PrintError(e.what());
+		}
+		output.flush();
+		std::cout << "\n\n";
+		std::cout.flush();
+	}
+}
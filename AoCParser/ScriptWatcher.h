@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+
+// Runs a script every time it is saved, started with --watch.
+// The globals are kept after the slow top level statements of a run, e.g. the load of a large input, and the next run continues
+// from the last of them before the first statement that changed, statements are compared by their tokens so comments and
+// blank lines don't count as changes. The output of the statements that aren't run again is written again from the earlier run.
+// A load statement is run again when the file it read has changed, the inputs are watched along with the script.
+// Changes are noticed with inotify on Linux and by checking the modification times a few times a second elsewhere.
+class ScriptWatcher
+{
+public:
+	static double snapshotMilliseconds; // Statements that took at least this long since the last kept globals keep the globals after them.
+
+	// Runs until the process is stopped, returns the exit code when the script can't be read.
+	static int Run(const std::string& path);
+};
@@ -0,0 +1,498 @@
+#include "Server.h"
+#include "Parser.h"
+#include "InputCache.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+unsigned int Server::threads = 0;
+
+#if defined(_WIN32)
+
+int Server::Serve(const std::string& socketPath)
+{
+	(void)socketPath;
+	std::cerr << "--serve uses Unix domain sockets and isn't available on Windows" << std::endl;
+	return 1;
+}
+
+int Server::Connect(const std::string& socketPath, const std::string& script, const std::string& input)
+{
+	(void)socketPath; (void)script; (void)input;
+	std::cerr << "--connect uses Unix domain sockets and isn't available on Windows" << std::endl;
+	return 1;
+}
+
+#else
+
+using ServerClock = std::chrono::steady_clock;
+
+// A request is the magic, the working directory of the client, the script and the input, each ending with '\0'.
+// The server answers with frames of a type, a uint32_t length and the data, the last frame is the exit code.
+static const char RequestMagic[] = "AOC1";
+static const size_t RequestFields = 4;
+static const size_t MaxRequestSize = 1 << 16;
+static const size_t MaxBufferedOutput = 1 << 16;
+static const int RequestTimeoutSeconds = 10; // A client that connects and sends nothing only holds a worker this long.
+static const size_t MaxPrograms = 64; // Parsed scripts kept, the least recently used is dropped first.
+static const char FrameOutput = 'o';
+static const char FrameError = 'e';
+static const char FrameExit = 'x';
+
+static const int ExitScriptFailed = 2;
+static const int ExitNoServer = 5;
+
+static bool SendAll(int socket, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t sent = send(socket, data, size, 0);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			return false;
+		}
+		data += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+static bool ReceiveAll(int socket, char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t received = recv(socket, data, size, 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0) {
+			return false;
+		}
+		data += received;
+		size -= static_cast<size_t>(received);
+	}
+	return true;
+}
+
+static bool SendFrame(int socket, char type, const char* data, size_t size)
+{
+	char header[1 + sizeof(uint32_t)];
+	uint32_t length = static_cast<uint32_t>(size);
+	header[0] = type;
+	std::memcpy(header + 1, &length, sizeof(length));
+	return SendAll(socket, header, sizeof(header)) && SendAll(socket, data, size);
+}
+
+// Sends everything printed as output frames, the parser flushes after every statement so the client sees the output as it is printed.
+class SocketOutput : public std::streambuf
+{
+public:
+	SocketOutput(int socket) : socket(socket), connected(true) {}
+
+protected:
+	virtual int_type overflow(int_type c) override {
+		if (c != traits_type::eof()) {
+			buffer.push_back(static_cast<char>(c));
+			sendFull();
+		}
+		return traits_type::not_eof(c);
+	}
+
+	virtual std::streamsize xsputn(const char* s, std::streamsize count) override {
+		buffer.append(s, static_cast<size_t>(count));
+		sendFull();
+		return count;
+	}
+
+	virtual int sync() override {
+		// A client that went away only loses the output, the script still runs to the end.
+		if (!buffer.empty() && connected) {
+			connected = SendFrame(socket, FrameOutput, buffer.data(), buffer.size());
+		}
+		buffer.clear();
+		return 0;
+	}
+
+private:
+	void sendFull() {
+		if (buffer.size() >= MaxBufferedOutput) {
+			sync();
+		}
+	}
+
+	int socket;
+	bool connected;
+	std::string buffer;
+};
+
+struct ServerProgram
+{
+	std::string code;
+	std::unique_ptr<Parser> parser;
+	uint64_t lastUse = 0;
+};
+
+struct ProgramTable
+{
+	std::mutex mutex;
+	std::map<std::string, std::shared_ptr<ServerProgram>> programs;
+	uint64_t uses = 0;
+};
+
+static ProgramTable& Programs()
+{
+	static ProgramTable table;
+	return table;
+}
+
+// Returns the parsed script, parsing it again when the source has changed. Runs still using the old program keep it alive.
+static std::shared_ptr<ServerProgram> LoadProgram(const std::string& path)
+{
+	// ReadFile throws its own error for a missing file, the client is told about the script rather than an input.
+	std::string code;
+	if (InputCache::Version(path).empty() || !ReadFile(path, code)) {
+		throw std::invalid_argument("File not found: " + path);
+	}
+
+	// Parsed while holding the lock, a script sent by several clients at once is only parsed once.
+	ProgramTable& table = Programs();
+	std::lock_guard<std::mutex> lock(table.mutex);
+	std::shared_ptr<ServerProgram> program;
+	auto found = table.programs.find(path);
+	if (found != table.programs.end() && found->second->code == code) {
+		program = found->second;
+	}
+	else {
+		// Only added once it has parsed, a syntax error leaves the table as it was.
+		program = std::make_shared<ServerProgram>();
+		program->parser.reset(new Parser(code));
+		program->code = std::move(code);
+		table.programs[path] = program;
+	}
+	program->lastUse = ++table.uses;
+
+	// Runs still using a dropped program keep it until they finish.
+	while (table.programs.size() > MaxPrograms)
+	{
+		auto oldest = table.programs.begin();
+		for (auto it = table.programs.begin(); it != table.programs.end(); ++it)
+		{
+			if (it->second->lastUse < oldest->second->lastUse) {
+				oldest = it;
+			}
+		}
+		table.programs.erase(oldest);
+	}
+	return program;
+}
+
+static bool ReceiveRequest(int socket, std::vector<std::string>& fields)
+{
+	std::string request;
+	char chunk[4096];
+	while (std::count(request.begin(), request.end(), '\0') < static_cast<std::ptrdiff_t>(RequestFields))
+	{
+		ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0 || request.size() + static_cast<size_t>(received) > MaxRequestSize) {
+			return false;
+		}
+		request.append(chunk, static_cast<size_t>(received));
+	}
+
+	size_t start = 0;
+	for (size_t i = 0; i < RequestFields; i++)
+	{
+		size_t end = request.find('\0', start);
+		fields.push_back(request.substr(start, end - start));
+		start = end + 1;
+	}
+	return fields[0] == RequestMagic;
+}
+
+static void RunRequest(int socket)
+{
+	ServerClock::time_point start = ServerClock::now();
+	timeval timeout = {};
+	timeout.tv_sec = RequestTimeoutSeconds;
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	std::vector<std::string> fields;
+	if (!ReceiveRequest(socket, fields)) {
+		close(socket);
+		return;
+	}
+	const std::string& script = fields[2];
+	const std::string& input = fields[3];
+
+	SocketOutput buffer(socket);
+	std::ostream output(&buffer);
+	output << ConsoleColorToString(CONSOLE_COLOR::CYAN) << "Run code : " << script << "\n" << ConsoleColorToString(CONSOLE_COLOR::RESET);
+
+	RuntimeGlobals globals;
+	globals.output = &output;
+	globals.InputFileName = input;
+	globals.WorkingDirectory = fields[1];
+	std::string error;
+	try {
+		std::shared_ptr<ServerProgram> program = LoadProgram(globals.ResolvePath(script));
+		program->parser->Run(&globals);
+		output << "\n\n";
+	}
+	catch (const std::exception& e) {
+		error = e.what();
+	}
+	output.flush();
+
+	int32_t exitCode = error.empty() ? 0 : ExitScriptFailed;
+	if (!error.empty()) {
+		std::string message = ConsoleColorToString(CONSOLE_COLOR::RED) + error + ConsoleColorToString(CONSOLE_COLOR::RESET) + "\n";
+		SendFrame(socket, FrameError, message.data(), message.size());
+	}
+	SendFrame(socket, FrameExit, reinterpret_cast<const char*>(&exitCode), sizeof(exitCode));
+	close(socket);
+
+	double milliseconds = std::chrono::duration<double, std::milli>(ServerClock::now() - start).count();
+	std::cout << (error.empty() ? "PASS" : "FAIL") << std::fixed << std::setprecision(1) << std::setw(10) << milliseconds << " ms  " << script;
+	if (!input.empty()) {
+		std::cout << " " << input;
+	}
+	std::cout << std::endl;
+}
+
+static bool MakeAddress(const std::string& socketPath, sockaddr_un& address)
+{
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.length() >= sizeof(address.sun_path)) {
+		std::cerr << "Socket path is too long: " << socketPath << std::endl;
+		return false;
+	}
+	std::memcpy(address.sun_path, socketPath.c_str(), socketPath.length() + 1);
+	return true;
+}
+
+static bool ConnectTo(const sockaddr_un& address, int& connection)
+{
+	connection = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connection < 0) {
+		return false;
+	}
+	if (connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		close(connection);
+		connection = -1;
+		return false;
+	}
+	return true;
+}
+
+// The socket file is removed when the server is stopped with Ctrl+C or kill.
+static char SocketFile[sizeof(sockaddr_un::sun_path)] = {};
+
+static void StopServer(int signal)
+{
+	(void)signal;
+	unlink(SocketFile);
+	_exit(0);
+}
+
+int Server::Serve(const std::string& socketPath)
+{
+	sockaddr_un address;
+	if (!MakeAddress(socketPath, address)) {
+		return 1;
+	}
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	bool bound = listener >= 0 && bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+	if (!bound && listener >= 0 && errno == EADDRINUSE) {
+		// Left behind by a server that was killed, unless another server still answers on it.
+		int running = -1;
+		if (ConnectTo(address, running)) {
+			close(running);
+			std::cerr << "A server is already running on " << socketPath << std::endl;
+			close(listener);
+			return 1;
+		}
+		unlink(socketPath.c_str());
+		bound = bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+	}
+	if (!bound || listen(listener, SOMAXCONN) != 0) {
+		std::cerr << "Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+		if (listener >= 0) {
+			close(listener);
+		}
+		return 1;
+	}
+
+	std::memcpy(SocketFile, address.sun_path, sizeof(SocketFile));
+	std::signal(SIGINT, StopServer);
+	std::signal(SIGTERM, StopServer);
+	std::signal(SIGPIPE, SIG_IGN); // A client that went away is a failed send, not the end of the server.
+	SetColorsEnabled(true);
+
+	size_t threadCount = threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+	std::mutex mutex;
+	std::condition_variable available;
+	std::queue<int> connections;
+	auto worker = [&]() {
+		while (true)
+		{
+			int connection;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				available.wait(lock, [&]() { return !connections.empty(); });
+				connection = connections.front();
+				connections.pop();
+			}
+			RunRequest(connection);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		workers.emplace_back(worker);
+	}
+
+	std::cout << "Serving on " << socketPath << " with " << threadCount << " threads" << std::endl;
+	while (true)
+	{
+		int connection = accept(listener, nullptr, nullptr);
+		if (connection < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			std::cerr << "Could not accept connections on " << socketPath << ": " << std::strerror(errno) << std::endl;
+			StopServer(0);
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			connections.push(connection);
+		}
+		available.notify_one();
+	}
+}
+
+// Removes the escape codes of colors, for a client whose output has colors disabled.
+class ColorFilter
+{
+public:
+	ColorFilter(bool colors) : colors(colors), state(TEXT) {}
+
+	void write(std::ostream& out, const std::string& data) {
+		if (colors) {
+			out << data;
+			return;
+		}
+		std::string text;
+		for (char c : data)
+		{
+			if (state == TEXT && c == '\033') {
+				state = ESCAPE;
+			}
+			else if (state == ESCAPE) {
+				state = c == '[' ? SEQUENCE : TEXT;
+			}
+			else if (state == SEQUENCE) {
+				state = c >= '@' && c <= '~' ? TEXT : SEQUENCE;
+			}
+			else {
+				text.push_back(c);
+			}
+		}
+		out << text;
+	}
+
+private:
+	bool colors;
+	enum { TEXT, ESCAPE, SEQUENCE } state; // Escape codes can be split over two frames.
+};
+
+int Server::Connect(const std::string& socketPath, const std::string& script, const std::string& input)
+{
+	sockaddr_un address;
+	int connection = -1;
+	if (!MakeAddress(socketPath, address)) {
+		return ExitNoServer;
+	}
+	if (!ConnectTo(address, connection)) {
+		PushConsoleColor(CONSOLE_COLOR::RED);
+		std::cerr << "Could not connect to a server on " << socketPath << ": " << std::strerror(errno) << std::endl;
+		PopConsoleColor();
+		return ExitNoServer;
+	}
+
+	char directory[PATH_MAX];
+	if (getcwd(directory, sizeof(directory)) == nullptr) {
+		directory[0] = '\0';
+	}
+	std::string request;
+	for (const std::string& field : { std::string(RequestMagic), std::string(directory), script, input })
+	{
+		request.append(field);
+		request.push_back('\0');
+	}
+	std::signal(SIGPIPE, SIG_IGN);
+	bool sent = SendAll(connection, request.data(), request.size());
+
+	ColorFilter output(GetColorsEnabled());
+	ColorFilter errors(GetColorsEnabled());
+	int exitCode = -1;
+	char header[1 + sizeof(uint32_t)];
+	while (sent && exitCode < 0 && ReceiveAll(connection, header, sizeof(header)))
+	{
+		uint32_t length;
+		std::memcpy(&length, header + 1, sizeof(length));
+		std::string data(length, '\0');
+		if (!ReceiveAll(connection, &data[0], length)) {
+			break;
+		}
+		if (header[0] == FrameOutput) {
+			output.write(std::cout, data);
+			std::cout.flush();
+		}
+		else if (header[0] == FrameError) {
+			std::cout.flush();
+			errors.write(std::cerr, data);
+		}
+		else if (header[0] == FrameExit && length == sizeof(int32_t)) {
+			int32_t code;
+			std::memcpy(&code, data.data(), sizeof(code));
+			exitCode = code;
+		}
+	}
+	close(connection);
+
+	if (exitCode < 0) {
+		PushConsoleColor(CONSOLE_COLOR::RED);
+		std::cerr << "The server on " << socketPath << " closed the connection before the script finished" << std::endl;
+		PopConsoleColor();
+		return ExitNoServer;
+	}
+	return exitCode;
+}
+
+#endif
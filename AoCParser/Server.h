@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+
+// Keeps parsed scripts and loaded inputs in memory between runs, started with --serve SOCKET.
+// Clients started with --connect SOCKET send the script, the input and their working directory over the Unix domain socket,
+// the server runs it on one of its threads in its own globals and streams the output back as it is printed:
+//	AoCParser --serve /tmp/aoc.sock -j 4 &
+//	AoCParser --connect /tmp/aoc.sock days/day1.aoc --input input/other_Day1.txt
+// A script is parsed again when its source has changed, an input is read again when its modification time or size has.
+// Unix domain sockets are only used on POSIX systems, on Windows both modes report that they aren't available.
+class Server
+{
+public:
+	static unsigned int threads; // Number of runs at the same time, 0 uses all cores. Set with -j.
+
+	// Runs until the server is killed, returns the exit code when the socket can't be opened.
+	static int Serve(const std::string& socketPath);
+
+	// Runs the script on the server and writes its output. input is empty to run the script with the input it loads itself.
+	// Returns 0 when the script ran, 2 when it failed, e.g. on an assert, and 5 when there is no server on the socket.
+	static int Connect(const std::string& socketPath, const std::string& script, const std::string& input);
+};
@@ -0,0 +1,176 @@
+#include "Stats.h"
+#include "PerfCounters.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <vector>
+
+bool Stats::enabled = false;
+bool Stats::timePhases = false;
+
+static const char* PhaseNames[] = { "none", "tokenize", "parse", "execute" };
+
+void StatCounters::add(const StatCounters& other)
+{
+	for (const auto& node : other.nodes)
+	{
+		nodes[node.first] += node.second;
+	}
+	variableReads += other.variableReads;
+	variableWrites += other.variableWrites;
+	variableSlots = std::max(variableSlots, other.variableSlots);
+	maxDepth = std::max(maxDepth, other.maxDepth);
+	listAllocations += other.listAllocations;
+	listReallocations += other.listReallocations;
+	stringAllocations += other.stringAllocations;
+	stringBytes += other.stringBytes;
+	sortedInserts += other.sortedInserts;
+	sortedResorts += other.sortedResorts;
+	tokensLexed += other.tokensLexed;
+	tokensPeeked += other.tokensPeeked;
+	for (int i = 0; i < static_cast<int>(StatPhase::COUNT); i++)
+	{
+		phases[i] += other.phases[i];
+	}
+}
+
+struct StatTotals
+{
+	std::mutex mutex;
+	StatCounters counters;
+};
+
+static StatTotals& Totals()
+{
+	static StatTotals totals;
+	return totals;
+}
+
+// Adds the counters of a thread to the totals when the thread exits.
+struct ThreadStats
+{
+	StatCounters counters;
+	~ThreadStats() {
+		StatTotals& totals = Totals();
+		std::lock_guard<std::mutex> lock(totals.mutex);
+		totals.counters.add(counters);
+	}
+};
+
+StatCounters& Stats::Local()
+{
+	static thread_local ThreadStats stats;
+	return stats.counters;
+}
+
+StatPhase Stats::SwitchPhase(StatPhase phase)
+{
+	StatCounters& counters = Local();
+	StatsClock::time_point now = StatsClock::now();
+	if (counters.phase != StatPhase::NONE) {
+		counters.phases[static_cast<int>(counters.phase)] += now - counters.phaseStart;
+	}
+	StatPhase outer = counters.phase;
+	if (PerfCounters::enabled) {
+		PerfCounters::SwitchPhase(outer);
+	}
+	counters.phase = phase;
+	counters.phaseStart = now;
+	return outer;
+}
+
+static StatCounters Collect()
+{
+	StatTotals& totals = Totals();
+	std::lock_guard<std::mutex> lock(totals.mutex);
+	StatCounters counters = totals.counters;
+	counters.add(Stats::Local());
+	return counters;
+}
+
+static double PhaseMilliseconds(const StatCounters& counters, StatPhase phase)
+{
+	return std::chrono::duration<double, std::milli>(counters.phases[static_cast<int>(phase)]).count();
+}
+
+// The same literal can have a different address in every translation unit, the types are merged by name.
+static std::vector<std::pair<std::string, long long>> SortedNodes(const StatCounters& counters)
+{
+	std::map<std::string, long long> byName;
+	for (const auto& node : counters.nodes)
+	{
+		byName[node.first] += node.second;
+	}
+	std::vector<std::pair<std::string, long long>> nodes(byName.begin(), byName.end());
+	std::stable_sort(nodes.begin(), nodes.end(), [](const std::pair<std::string, long long>& a, const std::pair<std::string, long long>& b) {
+		return a.second > b.second;
+	});
+	return nodes;
+}
+
+void Stats::PrintReport(std::ostream& out)
+{
+	StatCounters counters = Collect();
+	std::vector<std::pair<std::string, long long>> nodes = SortedNodes(counters);
+	long long evaluated = 0;
+	for (const auto& node : nodes)
+	{
+		evaluated += node.second;
+	}
+
+	out << std::fixed << std::setprecision(2);
+	out << "Stats:\n";
+	out << std::left;
+	out << std::setw(20) << "  time ms" << "tokenize " << PhaseMilliseconds(counters, StatPhase::TOKENIZE)
+		<< ", parse " << PhaseMilliseconds(counters, StatPhase::PARSE)
+		<< ", execute " << PhaseMilliseconds(counters, StatPhase::EXECUTE) << "\n";
+	out << std::setw(20) << "  tokens" << "lexed " << counters.tokensLexed << ", peeked " << counters.tokensPeeked << "\n";
+	out << std::setw(20) << "  statements" << "max depth " << counters.maxDepth << "\n";
+	out << std::setw(20) << "  variables" << "reads " << counters.variableReads << ", writes " << counters.variableWrites
+		<< ", max slots " << counters.variableSlots << "\n";
+	out << std::setw(20) << "  lists" << "allocations " << counters.listAllocations << ", reallocations " << counters.listReallocations << "\n";
+	out << std::setw(20) << "  sorted lists" << "inserts " << counters.sortedInserts << ", resorts " << counters.sortedResorts << "\n";
+	out << std::setw(20) << "  strings" << "allocations " << counters.stringAllocations << ", bytes " << counters.stringBytes << "\n";
+	out << std::setw(20) << "  nodes evaluated" << evaluated << "\n";
+	for (const auto& node : nodes)
+	{
+		out << "    " << std::setw(20) << node.first << std::right << std::setw(14) << node.second << std::left << "\n";
+	}
+	out << std::right << std::defaultfloat << std::setprecision(6);
+}
+
+bool Stats::WriteJson(const std::string& filePath)
+{
+	std::ofstream file(filePath);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	StatCounters counters = Collect();
+	file << std::fixed << std::setprecision(3);
+	file << "{\n\t\"time_ms\": { ";
+	for (int phase = static_cast<int>(StatPhase::TOKENIZE); phase < static_cast<int>(StatPhase::COUNT); phase++)
+	{
+		file << (phase > static_cast<int>(StatPhase::TOKENIZE) ? ", " : "") << "\"" << PhaseNames[phase] << "\": "
+			<< PhaseMilliseconds(counters, static_cast<StatPhase>(phase));
+	}
+	file << " },\n";
+	file << "\t\"tokens\": { \"lexed\": " << counters.tokensLexed << ", \"peeked\": " << counters.tokensPeeked << " },\n";
+	file << "\t\"statements\": { \"max_depth\": " << counters.maxDepth << " },\n";
+	file << "\t\"variables\": { \"reads\": " << counters.variableReads << ", \"writes\": " << counters.variableWrites
+		<< ", \"max_slots\": " << counters.variableSlots << " },\n";
+	file << "\t\"lists\": { \"allocations\": " << counters.listAllocations << ", \"reallocations\": " << counters.listReallocations << " },\n";
+	file << "\t\"sorted_lists\": { \"inserts\": " << counters.sortedInserts << ", \"resorts\": " << counters.sortedResorts << " },\n";
+	file << "\t\"strings\": { \"allocations\": " << counters.stringAllocations << ", \"bytes\": " << counters.stringBytes << " },\n";
+	file << "\t\"nodes\": {";
+	std::vector<std::pair<std::string, long long>> nodes = SortedNodes(counters);
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		// Node names are C++ identifiers, nothing to escape.
+		file << (i > 0 ? "," : "") << "\n\t\t\"" << nodes[i].first << "\": " << nodes[i].second;
+	}
+	file << (nodes.empty() ? "" : "\n\t") << "}\n}\n";
+	return true;
+}
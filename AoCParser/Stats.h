@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <unordered_map>
+
+using StatsClock = std::chrono::steady_clock;
+
+enum class StatPhase
+{
+	NONE,
+	TOKENIZE,
+	PARSE,
+	EXECUTE,
+	COUNT
+};
+
+struct StatCounters
+{
+	std::unordered_map<const char*, long long> nodes; // Evaluations per node type, keyed by the name literal of the type.
+	long long variableReads = 0;
+	long long variableWrites = 0;
+	long long variableSlots = 0;	// Most variable slots a RuntimeGlobals has grown to.
+	long long maxDepth = 0;			// Deepest nesting of statements, e.g. an if in a loop is 2.
+	long long listAllocations = 0;
+	long long listReallocations = 0;	// Appends that had to grow the storage of the list.
+	long long stringAllocations = 0;	// String values built at runtime, interned strings are not counted.
+	long long stringBytes = 0;
+	long long sortedInserts = 0;
+	long long sortedResorts = 0;
+	long long tokensLexed = 0;
+	long long tokensPeeked = 0;
+	StatsClock::duration phases[static_cast<int>(StatPhase::COUNT)] = {};
+
+	// Only used while running, not part of the report.
+	long long depth = 0;
+	StatPhase phase = StatPhase::NONE;
+	StatsClock::time_point phaseStart;
+
+	void add(const StatCounters& other);
+};
+
+// Interpreter counters, enabled with --stats.
+// The hooks are always compiled in, when disabled each one costs a branch on Stats::enabled.
+// Every thread counts into its own counters, so parallel loops and batch jobs don't contend, and adds them to the totals when it exits.
+class Stats
+{
+public:
+	static bool enabled;
+	// The phases are also timed for --perf-counters, which reads its counters whenever the phase changes.
+	static bool timePhases;
+
+	// Counters of the calling thread.
+	static StatCounters& Local();
+
+	static void Count(long long StatCounters::* counter, long long amount = 1) {
+		if (enabled) { Local().*counter += amount; }
+	}
+	static void CountMax(long long StatCounters::* counter, long long value) {
+		if (enabled && value > Local().*counter) { Local().*counter = value; }
+	}
+	static void CountNode(const char* type) {
+		if (enabled) { ++Local().nodes[type]; }
+	}
+	static void CountString(size_t bytes) {
+		if (enabled) { Local().stringAllocations++; Local().stringBytes += static_cast<long long>(bytes); }
+	}
+
+	// Time from now on is added to 'phase', returns the phase that was running.
+	static StatPhase SwitchPhase(StatPhase phase);
+
+	// Totals of the threads that have exited and the calling thread, the other threads must be done.
+	static void PrintReport(std::ostream& out);
+	static bool WriteJson(const std::string& filePath);
+};
+
+// Time spent in a nested phase is only added to the inner phase, e.g. tokenizing while parsing.
+class StatsPhaseScope
+{
+public:
+	StatsPhaseScope(StatPhase phase) : outer(Stats::timePhases ? Stats::SwitchPhase(phase) : StatPhase::COUNT) {}
+	~StatsPhaseScope() { if (outer != StatPhase::COUNT) { Stats::SwitchPhase(outer); } }
+private:
+	StatPhase outer; // COUNT when the phases weren't timed on entry.
+};
+
+class StatsDepthScope
+{
+public:
+	StatsDepthScope() : counted(Stats::enabled) {
+		if (counted) {
+			StatCounters& counters = Stats::Local();
+			if (++counters.depth > counters.maxDepth) {
+				counters.maxDepth = counters.depth;
+			}
+		}
+	}
+	~StatsDepthScope() { if (counted) { Stats::Local().depth--; } }
+private:
+	bool counted;
+};
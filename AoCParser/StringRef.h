@@ -0,0 +1,52 @@
+#pragma once
+#include <cstring>
+#include <ostream>
+#include <string>
+
+// A read-only view of characters owned by someone else, e.g. a line in the text of a Day input.
+// Compares like std::string, str() makes an owned copy.
+class StringRef
+{
+public:
+	StringRef() : chars(""), count(0) {}
+	StringRef(const char* chars, size_t count) : chars(chars), count(count) {}
+	StringRef(const std::string& str) : chars(str.data()), count(str.size()) {}
+
+	const char* data() const { return chars; }
+	size_t size() const { return count; }
+	size_t length() const { return count; }
+	bool empty() const { return count == 0; }
+	char operator[](size_t index) const { return chars[index]; }
+	const char* begin() const { return chars; }
+	const char* end() const { return chars + count; }
+	std::string str() const { return std::string(chars, count); }
+
+	int compare(const StringRef& other) const {
+		int result = count != 0 && other.count != 0 ? std::memcmp(chars, other.chars, count < other.count ? count : other.count) : 0;
+		if (result != 0) {
+			return result;
+		}
+		return count < other.count ? -1 : (count > other.count ? 1 : 0);
+	}
+
+	bool operator==(const StringRef& other) const { return count == other.count && compare(other) == 0; }
+	bool operator!=(const StringRef& other) const { return !(*this == other); }
+	bool operator<(const StringRef& other) const { return compare(other) < 0; }
+	bool operator<=(const StringRef& other) const { return compare(other) <= 0; }
+	bool operator>(const StringRef& other) const { return compare(other) > 0; }
+	bool operator>=(const StringRef& other) const { return compare(other) >= 0; }
+
+private:
+	const char* chars;
+	size_t count;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const StringRef& str)
+{
+	return out.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+inline std::string& operator+=(std::string& str, const StringRef& other)
+{
+	return str.append(other.data(), other.size());
+}
@@ -0,0 +1,300 @@
+#include "TokenCache.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <direct.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::string TokenCache::directory = "";
+
+// Bumped whenever the layout below or the meaning of the tokens changes, e.g. when the Tokenizer learns a new keyword.
+static const uint32_t FormatVersion = 1;
+static const char Magic[4] = { 'A', 'O', 'C', 'T' };
+static const uint32_t ByteOrder = 0x01020304; // Files are written in the byte order of the machine.
+
+// Followed by the source, the string table and the tokens. Strings are a uint32_t length and the characters,
+// a token is its type, line, value and source line, the last two as indices into the string table.
+struct CacheHeader
+{
+	char magic[4];
+	uint32_t byteOrder;
+	uint32_t formatVersion;
+	uint32_t tokenTypes;
+	uint64_t sourceHash;
+	uint32_t sourceLength;
+	uint32_t stringCount;
+	uint32_t tokenCount;
+	uint32_t reserved;
+	uint64_t payloadHash; // Of everything after the header, a damaged file is lexed again.
+};
+
+struct CachedToken
+{
+	uint32_t type;
+	int32_t line;
+	uint32_t value;
+	uint32_t sourceLine;
+};
+
+// FNV-1a
+static uint64_t Hash(const char* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t HashSource(const std::string& code)
+{
+	return Hash(code.data(), code.length());
+}
+
+static void FillHeader(CacheHeader& header, const std::string& code)
+{
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.byteOrder = ByteOrder;
+	header.formatVersion = FormatVersion;
+	header.tokenTypes = static_cast<uint32_t>(TokenType::END) + 1;
+	header.sourceHash = HashSource(code);
+	header.sourceLength = static_cast<uint32_t>(code.length());
+}
+
+static std::string CachePath(const std::string& code)
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.tokens", static_cast<unsigned long long>(HashSource(code)));
+	return TokenCache::directory + "/" + name;
+}
+
+// Read-only view of a whole file, empty when the file doesn't exist.
+class MappedFile
+{
+public:
+	MappedFile(const std::string& path) : data(nullptr), size(0) {
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		mapping = nullptr;
+		LARGE_INTEGER fileSize;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			return;
+		}
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr) {
+			data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			size = data != nullptr ? static_cast<size_t>(fileSize.QuadPart) : 0;
+		}
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return;
+		}
+		struct stat info;
+		if (fstat(file, &info) == 0 && info.st_size > 0) {
+			void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapped != MAP_FAILED) {
+				data = static_cast<const char*>(mapped);
+				size = static_cast<size_t>(info.st_size);
+			}
+		}
+		close(file); // The mapping stays valid.
+#endif
+	}
+
+	~MappedFile() {
+#if defined(_WIN32)
+		if (data != nullptr) { UnmapViewOfFile(data); }
+		if (mapping != nullptr) { CloseHandle(mapping); }
+		if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+#else
+		if (data != nullptr) { munmap(const_cast<char*>(data), size); }
+#endif
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data;
+	size_t size;
+private:
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#endif
+};
+
+// Reads values from the mapped file, every read past the end fails instead.
+class CacheReader
+{
+public:
+	CacheReader(const char* data, size_t size) : data(data), size(size), offset(0) {}
+
+	template<typename T>
+	bool read(T& value) {
+		if (size - offset < sizeof(T)) {
+			return false;
+		}
+		std::memcpy(&value, data + offset, sizeof(T));
+		offset += sizeof(T);
+		return true;
+	}
+
+	bool read(std::string& str, size_t length) {
+		if (size - offset < length) {
+			return false;
+		}
+		str.assign(data + offset, length);
+		offset += length;
+		return true;
+	}
+
+	bool matches(const std::string& str) {
+		if (size - offset < str.length() || std::memcmp(data + offset, str.data(), str.length()) != 0) {
+			return false;
+		}
+		offset += str.length();
+		return true;
+	}
+
+	bool done() const { return offset == size; }
+
+private:
+	const char* data;
+	size_t size;
+	size_t offset;
+};
+
+bool TokenCache::Load(const std::string& code, std::vector<Token>& tokens, std::vector<std::string>& lines)
+{
+	MappedFile file(CachePath(code));
+	CacheReader reader(file.data, file.size);
+
+	CacheHeader expected;
+	FillHeader(expected, code);
+	CacheHeader header;
+	if (file.data == nullptr || !reader.read(header) || std::memcmp(header.magic, expected.magic, sizeof(Magic)) != 0
+		|| header.byteOrder != expected.byteOrder || header.formatVersion != expected.formatVersion || header.tokenTypes != expected.tokenTypes
+		|| header.sourceHash != expected.sourceHash || header.sourceLength != expected.sourceLength || !reader.matches(code)
+		|| header.stringCount > file.size || header.tokenCount > file.size
+		|| header.payloadHash != Hash(file.data + sizeof(header), file.size - sizeof(header))) {
+		return false;
+	}
+
+	std::vector<std::string> strings(header.stringCount);
+	for (std::string& str : strings)
+	{
+		uint32_t length = 0;
+		if (!reader.read(length) || !reader.read(str, length)) {
+			return false;
+		}
+	}
+
+	tokens.clear();
+	lines.clear();
+	tokens.reserve(header.tokenCount);
+	lines.reserve(header.tokenCount);
+	for (uint32_t i = 0; i < header.tokenCount; i++)
+	{
+		CachedToken cached;
+		if (!reader.read(cached) || cached.type >= header.tokenTypes || cached.value >= strings.size() || cached.sourceLine >= strings.size()) {
+			return false;
+		}
+		Token token(static_cast<TokenType>(cached.type), strings[cached.value]);
+		token.line = cached.line;
+		tokens.push_back(token);
+		lines.push_back(strings[cached.sourceLine]);
+	}
+	return reader.done() && !tokens.empty() && tokens.back().type == TokenType::END;
+}
+
+void TokenCache::Store(const std::string& code, const std::vector<Token>& tokens, const std::vector<std::string>& lines)
+{
+#if defined(_WIN32)
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0777);
+#endif
+
+	// Values and lines repeat a lot, each distinct string is stored once.
+	std::vector<const std::string*> strings;
+	std::unordered_map<std::string, uint32_t> indices;
+	auto index = [&](const std::string& str) {
+		auto found = indices.emplace(str, static_cast<uint32_t>(strings.size()));
+		if (found.second) {
+			strings.push_back(&found.first->first);
+		}
+		return found.first->second;
+	};
+
+	std::vector<CachedToken> cached;
+	cached.reserve(tokens.size());
+	for (size_t i = 0; i < tokens.size(); i++)
+	{
+		uint32_t value = index(tokens[i].value);
+		cached.push_back(CachedToken{ static_cast<uint32_t>(tokens[i].type), tokens[i].line, value, index(lines[i]) });
+	}
+
+	CacheHeader header;
+	FillHeader(header, code);
+	header.stringCount = static_cast<uint32_t>(strings.size());
+	header.tokenCount = static_cast<uint32_t>(cached.size());
+	header.payloadHash = HashSource(code);
+	for (const std::string* str : strings)
+	{
+		uint32_t length = static_cast<uint32_t>(str->length());
+		header.payloadHash = Hash(reinterpret_cast<const char*>(&length), sizeof(length), header.payloadHash);
+		header.payloadHash = Hash(str->data(), str->length(), header.payloadHash);
+	}
+	header.payloadHash = Hash(reinterpret_cast<const char*>(cached.data()), cached.size() * sizeof(CachedToken), header.payloadHash);
+
+	// Written next to the final file and renamed, runs reading the cache at the same time never see half a file.
+	std::string path = CachePath(code);
+#if defined(_WIN32)
+	std::string temporaryPath = path + ".tmp" + std::to_string(_getpid());
+#else
+	std::string temporaryPath = path + ".tmp" + std::to_string(getpid());
+#endif
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		if (!file.is_open()) {
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(code.data(), code.length());
+		for (const std::string* str : strings)
+		{
+			uint32_t length = static_cast<uint32_t>(str->length());
+			file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+			file.write(str->data(), str->length());
+		}
+		file.write(reinterpret_cast<const char*>(cached.data()), cached.size() * sizeof(CachedToken));
+		if (!file) {
+			file.close();
+			std::remove(temporaryPath.c_str());
+			return;
+		}
+	}
+
+#if defined(_WIN32)
+	if (!MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		std::remove(temporaryPath.c_str());
+	}
+#else
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+	}
+#endif
+}
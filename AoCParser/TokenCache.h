@@ -0,0 +1,19 @@
+#pragma once
+#include "Tokenizer.h"
+#include <string>
+#include <vector>
+
+// Tokens of scripts that have been run before, enabled with --cache DIR.
+// Lexing with the regexes of the Tokenizer is most of the time of a short run, the tokens are written to DIR once a script
+// has been parsed and the next run of the same script replays them instead. Every file is named after a hash of the source
+// and holds the source itself, a file written for other code or by another version of the token format is ignored and overwritten.
+class TokenCache
+{
+public:
+	static std::string directory; // Empty disables the cache.
+
+	// Returns true when the cache has the tokens of exactly this code. lines holds the source line each token was read from.
+	static bool Load(const std::string& code, std::vector<Token>& tokens, std::vector<std::string>& lines);
+	// Best effort, the next run lexes the code again when the file can't be written.
+	static void Store(const std::string& code, const std::vector<Token>& tokens, const std::vector<std::string>& lines);
+};
@@ -1,12 +1,64 @@
 #include "Tokenizer.h"
+#include "TokenCache.h"
 #include <regex>
 #include <vector>
+#include <algorithm>
 
 void SyntaxError(std::string code)
 {
 	throw std::invalid_argument("Syntax error(tokenizer): invalid token { " + code + " }");
 }
 
+Tokenizer::Tokenizer(std::string code)
+	: nextToken(TokenType::END, ""), code(code), cursor(code), lineOffset(0), lineNumber(1), position(0), replaying(false), recording(false), tokenHash(0)
+{
+	if (!TokenCache::directory.empty()) {
+		StatsPhaseScope phase(StatPhase::TOKENIZE);
+		replaying = TokenCache::Load(code, tokens, tokenLines);
+		recording = !replaying;
+	}
+}
+
+bool Tokenizer::replayToken(bool consume)
+{
+	// The code ends with END, it is returned again for every token after it like when lexing.
+	size_t index = std::min(position, tokens.size() - 1);
+	nextToken = tokens[index];
+	lastLine = tokenLines[index];
+	if (consume && position < tokens.size()) {
+		position++;
+	}
+	return true;
+}
+
+void Tokenizer::record()
+{
+	if (!tokens.empty() && tokens.back().type == TokenType::END) {
+		return;
+	}
+	tokens.push_back(nextToken);
+	tokenLines.push_back(lastLine);
+}
+
+// FNV-1a over the type and value, the value is followed by a 0 so "a" "bc" and "ab" "c" differ.
+void Tokenizer::hash()
+{
+	tokenHash = (tokenHash ^ static_cast<uint64_t>(nextToken.type)) * 1099511628211ull;
+	for (char c : nextToken.value)
+	{
+		tokenHash = (tokenHash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+	}
+	tokenHash = tokenHash * 1099511628211ull;
+}
+
+void Tokenizer::CacheTokens()
+{
+	if (recording && !tokens.empty() && tokens.back().type == TokenType::END) {
+		TokenCache::Store(code, tokens, tokenLines);
+	}
+	recording = false;
+}
+
 bool Tokenizer::checkTokenMap(const std::vector<std::pair<std::regex, TokenType>>& tokenMap, std::string& line)
 {
 	for (auto& pair : tokenMap) {
@@ -22,14 +74,21 @@ bool Tokenizer::checkTokenMap(const std::vector<std::pair<std::regex, TokenType>
 
 bool Tokenizer::scanToken()
 {
+	StatsPhaseScope phase(StatPhase::TOKENIZE);
+	Stats::Count(&StatCounters::tokensLexed);
+
 	static const std::vector<std::pair<std::regex, TokenType>> multilineTokenMap = {
 	};
 
 	static const std::vector<std::pair<std::regex, TokenType>> singlelineTokenMap = {
 		std::pair<std::regex, TokenType>{std::regex(R"(^".*")")								, TokenType::STRING},
 		std::pair<std::regex, TokenType>{std::regex(R"(^simon says\b|^print\b)")			, TokenType::PRINT},
+		std::pair<std::regex, TokenType>{std::regex(R"(^debug\b)")							, TokenType::PRINT_DEBUG},
+		std::pair<std::regex, TokenType>{std::regex(R"(^trace\b)")							, TokenType::PRINT_TRACE},
 		std::pair<std::regex, TokenType>{std::regex(R"(^DAY\b)")							, TokenType::DAY},
 		std::pair<std::regex, TokenType>{std::regex(R"(^load\b)")							, TokenType::LOAD},
+		std::pair<std::regex, TokenType>{std::regex(R"(^columns\b)")						, TokenType::LOAD_COLUMNS},
+		std::pair<std::regex, TokenType>{std::regex(R"(^into\b)")							, TokenType::LOAD_INTO},
 		std::pair<std::regex, TokenType>{std::regex(R"(^if\b)")								, TokenType::IF},
 		std::pair<std::regex, TokenType>{std::regex(R"(^else\b)")							, TokenType::IF_ELSE},
 		std::pair<std::regex, TokenType>{std::regex(R"(^end\b)")							, TokenType::IF_CLOSE},
@@ -41,11 +100,18 @@ bool Tokenizer::scanToken()
 		std::pair<std::regex, TokenType>{std::regex(R"(^CHAR\b)")							, TokenType::CHAR},
 		std::pair<std::regex, TokenType>{std::regex(R"(^lines\b)")							, TokenType::LOOP_LINES},
 		std::pair<std::regex, TokenType>{std::regex(R"(^chars\b)")							, TokenType::LOOP_CHARS},
+		std::pair<std::regex, TokenType>{std::regex(R"(^rows\b)")							, TokenType::LOOP_ROWS},
+		std::pair<std::regex, TokenType>{std::regex(R"(^parallel\b)")						, TokenType::PARALLEL},
+		std::pair<std::regex, TokenType>{std::regex(R"(^reduce\b)")							, TokenType::LOOP_REDUCE},
 		std::pair<std::regex, TokenType>{std::regex(R"(^assert\b)")							, TokenType::ASSERT},
 		std::pair<std::regex, TokenType>{std::regex(R"(^list\b)")							, TokenType::LIST},
 		std::pair<std::regex, TokenType>{std::regex(R"(^sorted\b)")							, TokenType::LIST_SORTED},
 		std::pair<std::regex, TokenType>{std::regex(R"(^unsorted\b)")						, TokenType::LIST_UNSORTED},
+		std::pair<std::regex, TokenType>{std::regex(R"(^sort\b)")							, TokenType::LIST_SORT},
 		std::pair<std::regex, TokenType>{std::regex(R"(^size\b)")							, TokenType::ARRAY_SIZE},
+		std::pair<std::regex, TokenType>{std::regex(R"(^contains\b)")						, TokenType::LIST_CONTAINS},
+		std::pair<std::regex, TokenType>{std::regex(R"(^index\s+of\b)")					, TokenType::LIST_INDEX_OF},
+		std::pair<std::regex, TokenType>{std::regex(R"(^lower\s+bound\s+of\b)")			, TokenType::LIST_LOWER_BOUND},
 		std::pair<std::regex, TokenType>{std::regex(R"(^<<)")								, TokenType::LIST_ADD},
 		std::pair<std::regex, TokenType>{std::regex(R"(^\()")								, TokenType::LPAREN},
 		std::pair<std::regex, TokenType>{std::regex(R"(^\))")								, TokenType::RPAREN},
@@ -54,6 +120,7 @@ bool Tokenizer::scanToken()
 		std::pair<std::regex, TokenType>{std::regex(R"(^\{)")								, TokenType::LBRACE},
 		std::pair<std::regex, TokenType>{std::regex(R"(^\})")								, TokenType::RBRACE},
 		std::pair<std::regex, TokenType>{std::regex(R"(^:)")								, TokenType::COLON},
+		std::pair<std::regex, TokenType>{std::regex(R"(^,)")								, TokenType::COMMA},
 		std::pair<std::regex, TokenType>{std::regex(R"(^modulo\b)")							, TokenType::MODULO},
 		std::pair<std::regex, TokenType>{std::regex(R"(^as\b)")								, TokenType::CAST_AS},
 		std::pair<std::regex, TokenType>{std::regex(R"(^INTEGER\b)")						, TokenType::TYPE_INTEGER},
@@ -66,6 +133,7 @@ bool Tokenizer::scanToken()
 		std::pair<std::regex, TokenType>{std::regex(R"(^<=)")								, TokenType::LESS_EQUALS},
 		std::pair<std::regex, TokenType>{std::regex(R"(^>)")								, TokenType::GREATER_THAN},
 		std::pair<std::regex, TokenType>{std::regex(R"(^<)")								, TokenType::LESS_THAN},
+		std::pair<std::regex, TokenType>{std::regex(R"(^\+=)")								, TokenType::PLUS_EQUALS},
 		std::pair<std::regex, TokenType>{std::regex(R"(^\+)")								, TokenType::PLUS},
 		std::pair<std::regex, TokenType>{std::regex(R"(^-)")								, TokenType::MINUS},
 		std::pair<std::regex, TokenType>{std::regex(R"(^\*)")								, TokenType::MULTIPLY},
@@ -82,7 +150,7 @@ bool Tokenizer::scanToken()
 
 		// Remove leading single line comments '//'
 		std::smatch match;
-		while (std::regex_search(cursor, match, std::regex(R"(//.*\n)"))) {
+		while (std::regex_search(cursor, match, std::regex(R"(^//.*\n)"))) {
 			auto start = cursor.find(match.str());
 			if (start != cursor.npos) {
 				cursor = cursor.replace(start, match.str().length(), "");
@@ -94,6 +162,7 @@ bool Tokenizer::scanToken()
 	}
 
 	if (!cursor.empty()) {
+		int tokenLine = currentLine();
 		auto line = cursor;
 				
 		size_t newLinePos;
@@ -103,10 +172,12 @@ bool Tokenizer::scanToken()
 		lastLine = line;
 		
 		if (checkTokenMap(singlelineTokenMap, line)) {
+			nextToken.line = tokenLine;
 			return true;
 		}
 
 		if (checkTokenMap(multilineTokenMap, cursor)) { // Must check these cases before the newline token is skipped
+			nextToken.line = tokenLine;
 			return true;
 		}
 
@@ -118,6 +189,20 @@ bool Tokenizer::scanToken()
 	return true;
 }
 
+int Tokenizer::currentLine()
+{
+	// The cursor is what remains of the code, only count the newlines consumed since the last call.
+	size_t offset = code.length() - cursor.length();
+	if (offset < lineOffset) {
+		// PeekNextToken rewinds the cursor.
+		lineOffset = 0;
+		lineNumber = 1;
+	}
+	lineNumber += static_cast<int>(std::count(code.begin() + lineOffset, code.begin() + offset, '\n'));
+	lineOffset = offset;
+	return lineNumber;
+}
+
 void Tokenizer::print(Token token)
 {
 	switch (token.type)
@@ -2,6 +2,8 @@
 #include <string>
 #include <iostream>
 #include <regex>
+#include "Stats.h"
+#include <cstdint>
 #include <vector>
 
 enum class TokenType
@@ -14,11 +16,16 @@ enum class TokenType
 	MULTIPLY,	// '*'
 	DIVIDE,		// '/'
 	EQUALS,		// '='
+	PLUS_EQUALS,	// '+='
 	MODULO,		// 'modulo'
 
 	// Intrinsics
 	PRINT,		// 'print' | 'simon says'
+	PRINT_DEBUG,	// 'debug'
+	PRINT_TRACE,	// 'trace'
 	LOAD,		// 'load'
+	LOAD_COLUMNS,	// 'columns'
+	LOAD_INTO,	// 'into'
 	DAY,		// 'DAY'
 
 	// Variable types
@@ -40,6 +47,7 @@ enum class TokenType
 	IF_ELSE,	// "else"
 	IF_CLOSE,	// "end"
 	COLON,		// ":"
+	COMMA,		// ","
 
 	// LoopStatement
 	LOOP,		// 'loop'
@@ -49,6 +57,9 @@ enum class TokenType
 	CHAR, // 'CHAR'
 	LOOP_LINES, // 'lines'
 	LOOP_CHARS, // 'chars'
+	LOOP_ROWS, // 'rows'
+	PARALLEL, // 'parallel'
+	LOOP_REDUCE, // 'reduce'
 	LOOP_BREAK, // 'break'
 
 	// AssertStatement
@@ -75,6 +86,12 @@ enum class TokenType
 	LIST_SORTED,	// 'sorted'
 	LIST_UNSORTED,	// 'unsorted'
 	LIST_ADD,		// '<<'
+	LIST_SORT,		// 'sort'
+
+	// List searches. 'sum', 'product', 'min', 'max', 'in', 'concat', 'abs' and 'count' are IDs, the parser reads them as keywords where they fit
+	LIST_CONTAINS,	// 'contains'
+	LIST_INDEX_OF,	// 'index of'
+	LIST_LOWER_BOUND,	// 'lower bound of'
 
 	
 
@@ -86,10 +103,11 @@ enum class TokenType
 class Token
 {
 public:
-	Token() : type(TokenType::END), value("") {}
-	Token(TokenType type, std::string value) : type(type), value(value) {}
+	Token() : type(TokenType::END), value(""), line(0) {}
+	Token(TokenType type, std::string value) : type(type), value(value), line(0) {}
 	TokenType type;
 	std::string value;
+	int line; // Source line the token starts on, 1-based.
 
 	std::string ToString()
 	{
@@ -104,8 +122,13 @@ public:
 			case TokenType::ID:					{ type_string = "ID";		 }	break;
 			case TokenType::SEMICOLON:			{ type_string = "SEMICOLON"; }	break;
 			case TokenType::EQUALS:				{ type_string = "EQUALS";	 }	break;
+			case TokenType::PLUS_EQUALS:		{ type_string = "PLUS_EQUALS"; }	break;
 			case TokenType::PRINT:				{ type_string = "PRINT";	 }	break;
+			case TokenType::PRINT_DEBUG:		{ type_string = "PRINT_DEBUG"; }	break;
+			case TokenType::PRINT_TRACE:		{ type_string = "PRINT_TRACE"; }	break;
 			case TokenType::LOAD:				{ type_string = "LOAD";		 }	break;
+			case TokenType::LOAD_COLUMNS:		{ type_string = "LOAD_COLUMNS"; }	break;
+			case TokenType::LOAD_INTO:			{ type_string = "LOAD_INTO";	 }	break;
 			case TokenType::STRING:				{ type_string = "STRING";	 }	break;
 			case TokenType::MODULO:				{ type_string = "MODULO";	 }	break;
 
@@ -121,6 +144,7 @@ public:
 			case TokenType::IF_ELSE:				{ type_string = "IF_ELSE";	 }	break;
 			case TokenType::IF_CLOSE:				{ type_string = "IF_CLOSE";	 }	break;
 			case TokenType::COLON:				{ type_string = "COLON";	 }	break;
+			case TokenType::COMMA:				{ type_string = "COMMA";	 }	break;
 
 			// LoopStatement
 			case TokenType::LOOP: { type_string = "LOOP";	 }	break;
@@ -130,6 +154,9 @@ public:
 			case TokenType::CHAR: { type_string = "CHAR";	 }	break;
 			case TokenType::LOOP_LINES: { type_string = "LOOP_LINES";	 }	break;
 			case TokenType::LOOP_CHARS: { type_string = "LOOP_CHARS";	 }	break;
+			case TokenType::LOOP_ROWS: { type_string = "LOOP_ROWS";	 }	break;
+			case TokenType::PARALLEL: { type_string = "PARALLEL";	 }	break;
+			case TokenType::LOOP_REDUCE: { type_string = "LOOP_REDUCE";	 }	break;
 
 			// AssertStatement
 			case TokenType::ASSERT: { type_string = "ASSERT";	 }	break;
@@ -149,6 +176,10 @@ public:
 			case TokenType::LIST_ADD: { type_string = "LIST_ADD";	 }	break;
 			case TokenType::LIST_SORTED: { type_string = "LIST_SORTED";	 }	break;
 			case TokenType::LIST_UNSORTED: { type_string = "LIST_UNSORTED";	 }	break;
+			case TokenType::LIST_SORT: { type_string = "LIST_SORT";	 }	break;
+			case TokenType::LIST_CONTAINS: { type_string = "LIST_CONTAINS";	 }	break;
+			case TokenType::LIST_INDEX_OF: { type_string = "LIST_INDEX_OF";	 }	break;
+			case TokenType::LIST_LOWER_BOUND: { type_string = "LIST_LOWER_BOUND";	 }	break;
 
 			case TokenType::END:				{ type_string = "END";		 }	break;
 			default: { type_string = "UNIMPLEMENTED: Token::ToString (" + std::to_string(static_cast<int>(type));		 }break;
@@ -161,20 +192,31 @@ public:
 class Tokenizer
 {
 public:
-	Tokenizer(std::string code) : code(code), cursor(code), nextToken(TokenType::END, "") {};
+	// Replays the tokens from the TokenCache when it has this code, otherwise the code is lexed as it is parsed.
+	Tokenizer(std::string code);
 	~Tokenizer() = default;
 
 	void print(Token token);
 
 	bool GetNextToken(Token& outToken) {
-		bool result = scanToken();
+		bool result = replaying ? replayToken(true) : scanToken();
 		outToken = nextToken;
+		if (recording) { record(); }
+		hash();
 		return result;
 	}
 
 	/* Some time the next token is needed without consuming it, then Peeking is usable.
 	   Must manully call ConsumeNext to consume it or call GetNextToken again.. */
 	bool PeekNextToken(Token& outToken) {
+		Stats::Count(&StatCounters::tokensPeeked);
+		if (replaying) {
+			Token saveToken = nextToken;
+			bool result = replayToken(false);
+			outToken = nextToken;
+			nextToken = saveToken;
+			return result;
+		}
 		std::string saveCursor = cursor;
 		Token saveToken = nextToken;
 		bool result = scanToken();
@@ -185,20 +227,45 @@ public:
 	}
 
 	bool ConsumeNext() {
-		return scanToken();
+		bool result = replaying ? replayToken(true) : scanToken();
+		if (recording) { record(); }
+		hash();
+		return result;
 	}
 
+	// Hash of the tokens consumed since the last reset, the parser keeps one per top level statement for --watch.
+	// Lines aren't part of it, so a statement moved by an edit above it still has the same hash.
+	void ResetHash() { tokenHash = 14695981039346656037ull; }
+	uint64_t GetHash() const { return tokenHash; }
+
+	// Called once all of the code has been parsed, stores the lexed tokens in the TokenCache for the next run.
+	void CacheTokens();
+
 	std::string GetLastLine() {
 		return lastLine;
 	}
 
 private:
 	bool scanToken();
+	bool replayToken(bool consume);
+	void record();
+	void hash();
+	int currentLine();
 
 	Token nextToken;
 	std::string code;
 	std::string cursor;
 	std::string lastLine;
+	size_t lineOffset;
+	int lineNumber;
+
+	// Consumed tokens and the line each was read from, either recorded for the TokenCache or replayed from it.
+	std::vector<Token> tokens;
+	std::vector<std::string> tokenLines;
+	size_t position;
+	bool replaying;
+	bool recording;
+	uint64_t tokenHash;
 
 	bool checkTokenMap(const std::vector<std::pair<std::regex, TokenType>>& tokenMap, std::string& line);
 };
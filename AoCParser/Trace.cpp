@@ -0,0 +1,124 @@
+#include "Trace.h"
+#include "Profiler.h"
+#include "PrintHelper.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+bool Trace::enabled = false;
+int Trace::iterations = 100;
+thread_local int Trace::hiddenDepth = 0;
+
+using TraceClock = std::chrono::steady_clock;
+
+static const TraceClock::time_point Origin = TraceClock::now();
+
+struct TraceEvent
+{
+	int profileId;	// -1 for loop iterations.
+	int iteration;	// -1 for statements.
+	long long startNs;
+	long long endNs;
+};
+
+struct TraceThread
+{
+	int id;
+	std::vector<TraceEvent> events;
+};
+
+struct TraceTotals
+{
+	std::mutex mutex;
+	std::vector<TraceThread> threads;
+};
+
+static TraceTotals& Totals()
+{
+	static TraceTotals totals;
+	return totals;
+}
+
+// Hands the events of a thread over to the totals when the thread exits.
+struct ThreadTrace
+{
+	TraceThread thread;
+	ThreadTrace() {
+		static std::atomic<int> nextId(0);
+		thread.id = nextId++;
+	}
+	~ThreadTrace() {
+		if (thread.events.empty()) {
+			return;
+		}
+		TraceTotals& totals = Totals();
+		std::lock_guard<std::mutex> lock(totals.mutex);
+		totals.threads.push_back(std::move(thread));
+	}
+};
+
+static TraceThread& Local()
+{
+	static thread_local ThreadTrace trace;
+	return trace.thread;
+}
+
+long long Trace::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(TraceClock::now() - Origin).count();
+}
+
+void Trace::Record(int profileId, int iteration, long long startNs, long long endNs)
+{
+	Local().events.push_back(TraceEvent{ profileId, iteration, startNs, endNs });
+}
+
+bool Trace::Write(const std::string& filePath)
+{
+	std::ofstream file(filePath);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	TraceTotals& totals = Totals();
+	std::lock_guard<std::mutex> lock(totals.mutex);
+	std::vector<const TraceThread*> threads = { &Local() };
+	for (const TraceThread& thread : totals.threads)
+	{
+		threads.push_back(&thread);
+	}
+
+	// Timestamps are microseconds, complete events ('X') carry their own duration.
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"AoCParser\"}}";
+	for (const TraceThread* thread : threads)
+	{
+		file << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread->id
+			<< ", \"args\": {\"name\": \"" << (thread == threads.front() ? "main" : "thread " + std::to_string(thread->id)) << "\"}}";
+		for (const TraceEvent& event : thread->events)
+		{
+			file << ",\n{";
+			if (event.profileId >= 0) {
+				file << "\"name\": " << JsonString(Profiler::Source(event.profileId)) << ", \"cat\": \"statement\"";
+			}
+			else {
+				file << "\"name\": \"iteration\", \"cat\": \"iteration\"";
+			}
+			file << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->id
+				<< ", \"ts\": " << event.startNs / 1000.0 << ", \"dur\": " << (event.endNs - event.startNs) / 1000.0 << ", \"args\": {";
+			if (event.profileId >= 0) {
+				file << "\"line\": " << Profiler::Line(event.profileId);
+			}
+			else {
+				file << "\"ITER\": " << event.iteration;
+			}
+			file << "}}";
+		}
+	}
+	file << "\n]}\n";
+	return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+
+// Timeline of the run in the Chrome trace event format, enabled with --trace out.json and opened in ui.perfetto.dev or chrome://tracing.
+// Top level statements, loops and loads are recorded with their source line wherever they are nested, as are the iterations of loops.
+// Events are kept in memory by the thread that recorded them and only written when the program exits.
+class Trace
+{
+public:
+	static bool enabled;
+	// Every iteration of a loop is recorded up to this count, after that only every 'iterations'-th one. Set with --trace-iterations.
+	static int iterations;
+	// Iterations that aren't recorded hide everything nested in them, so inner loops don't fill the trace.
+	static thread_local int hiddenDepth;
+
+	static void Record(int profileId, int iteration, long long startNs, long long endNs);
+	static long long Now(); // Nanoseconds since the program started.
+
+	// Events of the threads that have exited and the calling thread, the other threads must be done.
+	static bool Write(const std::string& filePath);
+};
+
+// Records a statement registered with the profiler, nothing is recorded for a negative id.
+class TraceScope
+{
+public:
+	TraceScope(int profileId)
+		: profileId(Trace::enabled && Trace::hiddenDepth == 0 ? profileId : -1), start(this->profileId >= 0 ? Trace::Now() : 0) {}
+	~TraceScope() { if (profileId >= 0) { Trace::Record(profileId, -1, start, Trace::Now()); } }
+private:
+	int profileId;
+	long long start;
+};
+
+class TraceIterationScope
+{
+public:
+	TraceIterationScope(int iteration) : iteration(-1), hidden(false), start(0) {
+		if (Trace::enabled && Trace::hiddenDepth == 0) {
+			if (Sampled(iteration)) {
+				this->iteration = iteration;
+				start = Trace::Now();
+			}
+			else {
+				hidden = true;
+				++Trace::hiddenDepth;
+			}
+		}
+	}
+	~TraceIterationScope() {
+		if (iteration >= 0) {
+			Trace::Record(-1, iteration, start, Trace::Now());
+		}
+		else if (hidden) {
+			--Trace::hiddenDepth;
+		}
+	}
+private:
+	static bool Sampled(int iteration) {
+		return Trace::iterations > 0 && (iteration < Trace::iterations || iteration % Trace::iterations == 0);
+	}
+	int iteration;
+	bool hidden;
+	long long start;
+};
@@ -1,5 +1,18 @@
 #include <string>
 #include "Parser.h"
+#include "Profiler.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include "TokenCache.h"
+#include "InputCache.h"
+#include "ParallelLoop.h"
+#include "OutputSink.h"
+#include "BatchRunner.h"
+#include "Server.h"
+#include "ScriptWatcher.h"
+#include "Benchmark.h"
+#include <cstdlib>
 
 bool RunCode(std::string path, bool printSyntax = false)
 {
@@ -55,16 +68,38 @@ void RunTest(std::string path, bool& setOnFail)
 	}
 }
 
+// Passes when the script stops with an error, e.g. a use of an undefined variable.
+void RunFailingTest(std::string path, bool& setOnFail)
+{
+	try {
+		RunCode(path, false);
+	}
+	catch (const std::invalid_argument& e) {
+		(void)e; // The error is the expected result, it has already been displayed.
+		return;
+	}
+	PushConsoleColor(CONSOLE_COLOR::RED);
+	std::cout << "Expected an error: " << path << "\n" << std::endl;
+	PopConsoleColor();
+	setOnFail = true;
+}
+
 void RunAllTests()
 {
 	bool testsFailed = false;
 	std::cout << "RUNNING TESTS\n" << std::endl;
 	RunTest("days/day1.aoc", testsFailed);
 	RunTest("days/day1b.aoc", testsFailed);
+	RunTest("days/day1_reductions.aoc", testsFailed);
+	RunTest("days/day1_columns.aoc", testsFailed);
 	RunTest("days/day2.aoc", testsFailed);
 	RunTest("days/day2b.aoc", testsFailed);
+	RunTest("days/day2_rows.aoc", testsFailed);
+	RunTest("days/day2b_rows.aoc", testsFailed);
 	RunTest("days/day3.aoc", testsFailed);
 	RunTest("days/day3b.aoc", testsFailed);
+	RunTest("tests/keyword_variable_names.aoc", testsFailed);
+	RunFailingTest("tests/undefined_self_assign.aoc", testsFailed);
 
 	if (testsFailed) {
 		PushConsoleColor(CONSOLE_COLOR::RED);
@@ -95,9 +130,45 @@ void RunTests() {
 	}
 }
 
+void PrintProfile(std::string path, const std::string& foldedPath)
+{
+	std::cout << "\n";
+	Profiler::PrintReport(std::cout);
+	if (Profiler::WriteFoldedStacks(foldedPath, path)) {
+		std::cout << "Folded stacks written to: " << foldedPath << "\n";
+	}
+	else {
+		std::cerr << "Could not write folded stacks to: " << foldedPath << std::endl;
+	}
+}
+
+void WriteTrace(const std::string& tracePath)
+{
+	if (Trace::Write(tracePath)) {
+		std::cout << "Trace written to: " << tracePath << "\n";
+	}
+	else {
+		std::cerr << "Could not write trace to: " << tracePath << std::endl;
+	}
+}
+
+void PrintStats(const std::string& jsonPath)
+{
+	std::cout << "\n";
+	Stats::PrintReport(std::cout);
+	if (Stats::WriteJson(jsonPath)) {
+		std::cout << "Stats written to: " << jsonPath << "\n";
+	}
+	else {
+		std::cerr << "Could not write stats to: " << jsonPath << std::endl;
+	}
+}
+
 int main(int argc, char* argv[])
 {
 	InitializePrintHelper();
+	// Everything printed to std::cout is buffered and written in blocks, it is flushed after every statement of the script.
+	OutputSink console(std::cout, stdout);
 #if defined(_DEBUG)
 	if (argc >= 2) {
 		const int STR_EQUALS = 0;
@@ -109,10 +180,144 @@ int main(int argc, char* argv[])
 #elif defined(TEST_ALL)
 	RunExamples();
 	RunAllTests();
+#elif defined(BENCHMARK)
+	return Benchmark::RunSuite(argc, argv);
 #else
-	if (argc != 2) {
+	std::string aocSourceFile = "";
+	std::string batchManifest = "";
+	std::string tracePath = "";
+	std::string profilePath = "";
+	std::string statsPath = "";
+	std::string serveSocket = "";
+	std::string connectSocket = "";
+	std::string inputFile = "";
+	bool threadsSet = false;
+	bool watch = false;
+	bool badArguments = false;
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		if (argument == "--profile" && i + 1 < argc) {
+			profilePath = argv[++i];
+			Profiler::enabled = true;
+		}
+		else if (argument == "--stats" && i + 1 < argc) {
+			statsPath = argv[++i];
+			Stats::enabled = true;
+			Stats::timePhases = true;
+		}
+		else if (argument == "--perf-counters") {
+			PerfCounters::enabled = true;
+			Stats::timePhases = true;
+		}
+		else if (argument == "--trace" && i + 1 < argc) {
+			tracePath = argv[++i];
+			Trace::enabled = true;
+		}
+		else if (argument == "--cache" && i + 1 < argc) {
+			TokenCache::directory = argv[++i];
+		}
+		else if (argument == "--line-index") {
+			InputCache::lineIndexFiles = true;
+		}
+		else if (argument == "--trace-iterations" && i + 1 < argc) {
+			int iterations = std::atoi(argv[++i]);
+			if (iterations >= 0) {
+				Trace::iterations = iterations;
+			}
+			else {
+				badArguments = true;
+			}
+		}
+		else if (argument == "--quiet") {
+			PRINT_STATEMENT::threshold = PrintLevel::QUIET;
+		}
+		else if (argument == "--log-level" && i + 1 < argc) {
+			std::string level = argv[++i];
+			if (level == "print") {
+				PRINT_STATEMENT::threshold = PrintLevel::PRINT;
+			}
+			else if (level == "debug") {
+				PRINT_STATEMENT::threshold = PrintLevel::DEBUG;
+			}
+			else if (level == "trace") {
+				PRINT_STATEMENT::threshold = PrintLevel::TRACE;
+			}
+			else {
+				badArguments = true;
+			}
+		}
+		else if (argument == "--threads" && i + 1 < argc) {
+			int threads = std::atoi(argv[++i]);
+			if (threads > 0) {
+				PARALLEL_LOOP_DAY::threads = static_cast<unsigned int>(threads);
+				threadsSet = true;
+			}
+			else {
+				badArguments = true;
+			}
+		}
+		else if (argument == "--batch" && i + 1 < argc && batchManifest.empty()) {
+			batchManifest = argv[++i];
+		}
+		else if (argument == "--serve" && i + 1 < argc && serveSocket.empty()) {
+			serveSocket = argv[++i];
+		}
+		else if (argument == "--connect" && i + 1 < argc && connectSocket.empty()) {
+			connectSocket = argv[++i];
+		}
+		else if (argument == "--watch") {
+			watch = true;
+		}
+		else if (argument == "--input" && i + 1 < argc && inputFile.empty()) {
+			inputFile = argv[++i];
+		}
+		else if (argument == "-j" && i + 1 < argc) {
+			int jobs = std::atoi(argv[++i]);
+			if (jobs > 0) {
+				BatchRunner::threads = static_cast<unsigned int>(jobs);
+				Server::threads = static_cast<unsigned int>(jobs);
+			}
+			else {
+				badArguments = true;
+			}
+		}
+		else if (aocSourceFile.empty()) {
+			aocSourceFile = argument;
+		}
+		else {
+			badArguments = true;
+		}
+	}
+
+	// A batch runs instead of a single file, and the profiler and perf counters can't follow the jobs running on other threads.
+	if (!batchManifest.empty() && (!aocSourceFile.empty() || Profiler::enabled || PerfCounters::enabled)) {
+		badArguments = true;
+	}
+
+	// The server runs scripts sent by clients, and only options that apply to all of its runs are taken. The options of a client are
+	// the script and its input, everything else is set when the server is started.
+	bool instrumented = Profiler::enabled || Stats::enabled || PerfCounters::enabled || Trace::enabled;
+	if (!serveSocket.empty() && (!aocSourceFile.empty() || !batchManifest.empty() || !connectSocket.empty() || !inputFile.empty() || instrumented)) {
+		badArguments = true;
+	}
+	if (!connectSocket.empty() && (!batchManifest.empty() || instrumented || threadsSet || !TokenCache::directory.empty() || InputCache::lineIndexFiles)) {
+		badArguments = true;
+	}
+	if (!inputFile.empty() && connectSocket.empty()) {
+		badArguments = true;
+	}
+	// Every run of a watched script is a new program, the reports of the instrumented runs would add up the runs.
+	if (watch && (aocSourceFile.empty() || !batchManifest.empty() || !serveSocket.empty() || !connectSocket.empty() || instrumented)) {
+		badArguments = true;
+	}
+
+	if ((aocSourceFile.empty() && batchManifest.empty() && serveSocket.empty()) || badArguments) {
 		PushConsoleColor(CONSOLE_COLOR::RED);
-		std::cerr << "Must pass only one argument with the .aoc file to compile!" << std::endl;
+		std::cerr << "Must pass only one argument with the .aoc file to compile! Optionally followed by --profile out.folded, --stats stats.json, --perf-counters, --trace out.json, --trace-iterations N, --cache DIR, --line-index, --threads N, --quiet and --log-level print|debug|trace" << std::endl;
+		std::cerr << "Or --batch manifest.txt to run many scripts, optionally followed by -j N, --stats stats.json, --trace out.json, --cache DIR, --line-index, --threads N, --quiet and --log-level print|debug|trace" << std::endl;
+		std::cerr << "Or --serve SOCKET to keep scripts and inputs in memory, optionally followed by -j N, --cache DIR, --line-index, --threads N, --quiet and --log-level print|debug|trace" << std::endl;
+		std::cerr << "Or --connect SOCKET with the .aoc file to run it on the server, optionally followed by --input FILE" << std::endl;
+		std::cerr << "Or --watch with the .aoc file to run it again every time it is saved, optionally followed by --cache DIR, --line-index, --threads N, --quiet and --log-level print|debug|trace" << std::endl;
 		std::cerr << "Bad Arguments: ";
 		for (int i = 0; i < argc; i++) {
 			std::cerr << "'" << argv[i] << "' ";
@@ -123,9 +328,62 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
-	std::string aocSourceFile = argv[1];
+	if (!serveSocket.empty()) {
+		if (!threadsSet) {
+			// Runs of different clients already keep every core busy.
+			PARALLEL_LOOP_DAY::threads = 1;
+		}
+		return Server::Serve(serveSocket);
+	}
+
+	if (!connectSocket.empty()) {
+		return Server::Connect(connectSocket, aocSourceFile, inputFile);
+	}
+
+	if (!batchManifest.empty()) {
+		if (!threadsSet) {
+			// The jobs already keep every core busy.
+			PARALLEL_LOOP_DAY::threads = 1;
+		}
+		try {
+			bool passed = BatchRunner::Run(batchManifest, std::cout);
+			if (Stats::enabled) { PrintStats(statsPath); }
+			if (Trace::enabled) { WriteTrace(tracePath); }
+			return passed ? 0 : 4;
+		}
+		catch (const std::invalid_argument& e) {
+			PushConsoleColor(CONSOLE_COLOR::RED);
+			std::cerr << e.what() << std::endl;
+			PopConsoleColor();
+			return 2;
+		}
+	}
+
 	if (aocSourceFile.size() >= 4 && aocSourceFile.substr(aocSourceFile.size() - 4) == ".aoc") {
-		if (!RunCode(aocSourceFile)) {
+		if (watch) {
+			return ScriptWatcher::Run(aocSourceFile);
+		}
+		if (PerfCounters::enabled) { PerfCounters::Open(); }
+		bool found = false;
+		try {
+			found = RunCode(aocSourceFile);
+		}
+		catch (const std::invalid_argument&) {
+			// Still report where the time went when the script fails, e.g. on an assert.
+			if (Profiler::enabled) { PrintProfile(aocSourceFile, profilePath); }
+			if (Stats::enabled) { PrintStats(statsPath); }
+			if (PerfCounters::enabled) { std::cout << "\n"; PerfCounters::PrintReport(std::cout); }
+			if (Trace::enabled) { WriteTrace(tracePath); }
+			// Nothing is unwound once the exception leaves main, write the buffered output first.
+			std::cout.flush();
+			throw;
+		}
+
+		if (Profiler::enabled) { PrintProfile(aocSourceFile, profilePath); }
+		if (Stats::enabled) { PrintStats(statsPath); }
+		if (PerfCounters::enabled) { std::cout << "\n"; PerfCounters::PrintReport(std::cout); }
+		if (Trace::enabled) { WriteTrace(tracePath); }
+		if (!found) {
 			PushConsoleColor(CONSOLE_COLOR::RED);
 			std::cerr << "File not found: '" << aocSourceFile << "'" << std::endl;
 			PopConsoleColor();